@@ -0,0 +1,47 @@
+//    SAPF - Sound As Pure Form
+//    Copyright (C) 2019 James McCartney
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef __Bytecode_h__
+#define __Bytecode_h__
+
+#include "VM.hpp"
+#include <string>
+
+// Binary form of compiled code, so it can be loaded without parsing.
+// A file is a header, a table of the symbols it uses, then the FunDef tree. Builtins are
+// stored by name and looked up again on load, so a file stays valid across builds as long
+// as the builtins it names still exist. Only immutable values can be saved: numbers,
+// strings, symbols, packed lists, table maps, code and function definitions.
+
+const uint32_t kBytecodeMagic = 0x46504153; // "SAPF"
+const uint16_t kBytecodeVersion = 2;
+
+struct BytecodeHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize;
+	uint32_t numSymbols;
+	uint32_t bodyOffset; // from the start of the file, past the symbol table.
+};
+
+void writeBytecode(Thread& th, P<FunDef> const& def, std::string& out);
+P<FunDef> readBytecode(Thread& th, const uint8_t* data, size_t size);
+
+bool saveBytecodeFile(Thread& th, P<FunDef> const& def, const char* path);
+P<FunDef> loadBytecodeFile(Thread& th, const char* path);
+
+#endif
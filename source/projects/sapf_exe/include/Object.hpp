@@ -58,6 +58,7 @@ class Array;
 class V;
 
 class TableMap;
+class FormShape;
 
 typedef Object* O;
 typedef V const& Arg;
@@ -150,6 +151,7 @@ public:
 	bool done() const;
 	
 	void SetNoEachOps();
+	void SetPure();
 	
 	const char* TypeName() const;
 	const char* OneLineHelp() const;
@@ -238,7 +240,8 @@ inline V BinaryOp::stringOp(P<String> const& a, P<String> const& b) { throw errU
 typedef void (*PrimFun)(Thread& th, Prim*);
 
 enum {
-	flag_NoEachOps = 1
+	flag_NoEachOps = 1,
+	flag_Pure = 2  // a prim with no side effects, that can't fail for real args.
 };
 
 class Object : public RCObj
@@ -267,6 +270,8 @@ public:
 
 	bool NoEachOps() const { return flags & flag_NoEachOps; }
 	void SetNoEachOps() { flags |= flag_NoEachOps; }
+	bool IsPure() const { return flags & flag_Pure; }
+	void SetPure() { flags |= flag_Pure; }
 	
 	virtual bool isFinite() const { return finite; }
 	void setFinite(bool b) { finite = b; }
@@ -371,6 +376,7 @@ inline uint16_t V::takes() const { return o ? o->takes() : 0; }
 inline uint16_t V::leaves() const { return o ? o->leaves() : 1; }
 
 inline void V::SetNoEachOps() { if (o) o->SetNoEachOps(); }
+inline void V::SetPure() { if (o) o->SetPure(); }
 
 inline int64_t V::length(Thread& th) { return !o ? 1 : o->length(th); }
 inline Z V::atz(int64_t index) { return !o ? f : o->atz(index); }
@@ -474,12 +480,11 @@ class String : public Object
 public:	
 	char* s;
 	int32_t hash;
-	String* nextSymbol;
 		
-	String(const char* str, int32_t inHash, String* nextSymbol = nullptr) : Object(), nextSymbol(nextSymbol) { s = strdup(str); hash = inHash; }
-	String(const char* str) : Object(), nextSymbol(nullptr) { s = strdup(str); hash = ::Hash(s); }
+	String(const char* str, size_t len, int32_t inHash) : Object() { s = strndup(str, len); hash = inHash; }
+	String(const char* str) : Object() { s = strdup(str); hash = ::Hash(s); }
 	String(char* str, const char* dummy) 
-        : Object(), nextSymbol(nullptr) { s = str; hash = ::Hash(s); }
+        : Object() { s = str; hash = ::Hash(s); }
 
 	virtual ~String() { free(s); }
 	
@@ -878,6 +883,44 @@ public:
 
 	using Object::print;
 	virtual void print(Thread& th, std::string& out, int depth) override;
+
+	// shapes of the forms whose own table uses this map, one per parent shape, linked through mNextShape.
+	// shapes are only ever added at the head and are retained by the map, so readers need no lock.
+	std::atomic<FormShape*> mShapes = nullptr;
+};
+
+// A FormShape is the layout shared by all Forms whose chains are made of the same TableMaps, like a hidden class.
+// It holds one linearized map of every key visible through the chain, with the depth of the table holding it and
+// the slot within that table, so Form::get does one probe instead of one per ancestor.
+// Each shape has a serial number that inline caches compare against. Serial numbers are never reused; once they
+// run out, new shapes get zero and are not cached. Forms past the sharing limits have no shape and are searched
+// table by table.
+
+struct FormSlot
+{
+	int32_t depth;
+	int32_t index;
+};
+
+class FormShape : public Object
+{
+public:
+	P<FormShape> mParent;
+	P<TableMap> mKeys;
+	FormSlot* mSlots;
+	uint32_t mID;
+	int32_t mChainDepth;
+	FormShape* mNextShape = nullptr; // the next shape sharing this one's map. set before it is published.
+	
+	FormShape(TableMap* inMap, P<FormShape> const& inParent);
+	~FormShape();
+	
+	// returns the shared shape for a form with inTable and the parent inNext, or null past the sharing limits.
+	static P<FormShape> shapeFor(P<Table> const& inTable, P<Form> const& inNext);
+	
+	bool lookup(Arg inKey, int64_t inKeyHash, FormSlot& outSlot) const;
+	
+	virtual const char* TypeName() const override { return "FormShape"; }
 };
 
 class Table : public Object
@@ -908,6 +951,7 @@ class Form : public Object
 public:
 	P<Table> mTable;
 	P<Form> mNextForm;
+	P<FormShape> mShape;
 
 	Form(P<Table> const& inTable, P<Form> const& inNext = nullptr);
 	
@@ -932,6 +976,13 @@ public:
 	
 	virtual bool get(Thread& th, Arg key, V& value) const override;
 	
+	// get and dot through an inline cache, which holds the slot key had in the last shape seen.
+	// ioCache starts at zero and belongs to one call site, such as an opDot.
+	bool getCached(Thread& th, Arg key, uint64_t& ioCache, V& value) const;
+	bool dotCached(Thread& th, Arg key, uint64_t& ioCache, V& ioValue);
+	
+	V valueAt(FormSlot slot) const;
+	
     void put(int64_t inIndex, Arg inValue);
 	
 	virtual V mustGet(Thread& th, Arg key) const override;
@@ -1089,6 +1140,33 @@ public:
 	void getPlug(ZIn& outZIn, int& outChangeCount);
 };
 
+// A named control slot. Slots are global and found by name, so values can be set from outside
+// the running graph, e.g. by sapf~ 'set' messages. Reading never takes a lock.
+class Control : public Object
+{
+	std::atomic<Z> mValue;
+public:
+	P<String> mName;
+	
+	Control(P<String> const& inName, Z inValue) : mValue(inValue), mName(inName) {}
+
+	virtual const char* TypeName() const override { return "Control"; }
+
+	virtual bool Equals(Thread& th, Arg that) override
+	{
+		if (that.Identical(this)) return true;
+		return false;
+	}
+	
+	void setControl(Z inValue) { mValue.store(inValue, std::memory_order_relaxed); }
+	Z getControl() const { return mValue.load(std::memory_order_relaxed); }
+};
+
+// returns the slot with this name, making it with inValue if there is none.
+P<Control> getControl(P<String> const& inName, Z inValue);
+// sets the slot with this name, making it if there is none.
+void setControl(const char* inName, Z inValue);
+
 
 class Array : public Object
 {
@@ -1099,6 +1177,7 @@ class Array : public Object
 		V* vv;
 		Z* zz;
 	};
+	P<Array> mBase; // set when this is a view of items owned by mBase. copied on first change.
 
 public:
 
@@ -1108,6 +1187,14 @@ public:
 		alloc(std::max(int64_t(1), inCap));
 	}
 	
+	// a view of inSize signal items of inBase starting at inOffset, sharing its storage.
+	Array(P<Array> const& inBase, int64_t inOffset, int64_t inSize)
+		: mSize(inSize), mCap(inSize), p(inBase->zz + inOffset), mBase(inBase->mBase ? inBase->mBase : inBase)
+	{
+		assert(inBase->isZ());
+		elemType = itemTypeZ;
+	}
+	
 	virtual ~Array();
 
 	virtual const char* TypeName() const override { return "Array"; }
@@ -1121,6 +1208,7 @@ public:
 	
 	size_t elemSize() { return isV() ? sizeof(V) : sizeof(Z); }
 	void alloc(int64_t inCap);
+	bool isView() const { return mBase() != nullptr; }
 
 	int64_t size() const { return mSize; }
     void setSize(size_t inSize) { mSize = inSize; }
@@ -1324,6 +1412,7 @@ struct Opcode
 
 	int op;
 	V v;
+	uint64_t cache = 0; // inline cache for opDot. see Form::getCached.
 };
 
 class Code : public Object
@@ -82,6 +82,11 @@ struct Rate
 		set(inParent.sampleRate, inParent.blockSize, inDiv);
 	}
 		
+	Rate(Rate const& inParent, int inDiv, int inMul)
+	{
+		set(inParent.sampleRate * inMul, inParent.blockSize * inMul, inDiv);
+	}
+		
 	Rate(double inSampleRate, int inBlockSize)
 	{
 		set(inSampleRate, inBlockSize, 1);
@@ -155,6 +160,8 @@ public:
 	
 	int parsingWhat;
 	bool fromString;
+	int errorLine = 0;		// position of the last syntax error.
+	int errorColumn = 0;
 	
 	// edit line
 #if USE_LIBEDIT
@@ -181,6 +188,7 @@ public:
 	}
 	void unget(int n) { linepos -= n; }
 	void unget(const char* s) { linepos -= curline() - s; }
+	void advance(const char* s) { linepos += s - curline(); }
 	char c() { return line[linepos]; }
 	char d() { return line[linepos] ? line[linepos+1] : 0; }
 	char getc();
@@ -307,6 +315,15 @@ public:
 	void repl(FILE* infile, const char* logfilename);
 };
 
+struct BifHelp
+{
+	const char* name;
+	const char* mask;
+	const char* help;
+};
+
+const size_t kBifHelpReserve = 1536;
+
 class VM
 {
 public:
@@ -356,24 +373,16 @@ public:
 	std::atomic<int64_t> totalStreamGenerators;
 #endif
 
-	std::vector<std::string> bifHelp;
+	// builtin help is registered once at startup, from a single thread, and every string is a
+	// literal or owned by a builtin that is never freed, so entries just point at it.
+	std::vector<BifHelp> bifHelp;
 	std::vector<std::string> udfHelp;
 
-	void addBifHelp(std::string const& str) { Locker lock(&gHelpMutex); bifHelp.push_back(str); }
 	void addUdfHelp(std::string const& str) { Locker lock(&gHelpMutex); udfHelp.push_back(str); }
 
 	void addBifHelp(const char* name, const char* mask = nullptr, const char* help = nullptr) 
 	{ 	
-		std::string helpstr = name;
-		if (mask) {
-			helpstr += " @";
-			helpstr += mask;
-		}
-		if (help) {
-			helpstr += " ";
-			helpstr += help;
-		}
-		addBifHelp(helpstr);
+		bifHelp.push_back({ name, mask, help });
 	}
 	void addUdfHelp(const char* name, const char* mask = nullptr, const char* help = nullptr)
 	{
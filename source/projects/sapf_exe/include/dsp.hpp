@@ -17,6 +17,7 @@
 #ifndef __taggeddoubles__dsp__
 #define __taggeddoubles__dsp__
 
+#include "Object.hpp"
 #include <Accelerate/Accelerate.h>
 
 const int kMinFFTLogSize = 2;
@@ -34,4 +35,22 @@ void ifft(int n, double* inReal, double* inImag, double* outReal, double* outIma
 void rfft(int n, double* inReal, double* outReal, double* outImag);
 void rifft(int n, double* inReal, double* inImag, double* outReal);
 
+// Window functions. Each window of up to kMaxCachedWindowSize points is computed once per type, size
+// and parameter, and the array is shared by everything that asks for it afterwards, so it must not
+// be modified. Larger windows are computed on every call. Thread safe.
+enum {
+	kWindowHann,
+	kWindowHamming,
+	kWindowBlackman,
+	kWindowBlackmanHarris,
+	kWindowKaiser,   // param is the stop band attenuation in dB.
+	kWindowGaussian, // param is the standard deviation as a fraction of half the window.
+	kWindowTukey     // param is the fraction of the window taken up by the cosine tapers.
+};
+
+const size_t kMaxCachedWindows = 256;
+const int64_t kMaxCachedWindowSize = 65536;
+
+P<Array> getWindow(int type, int64_t n, double param = 0.);
+
 #endif /* defined(__taggeddoubles__dsp__) */
@@ -14,6 +14,9 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#ifndef __primes_h__
+#define __primes_h__
+
 #include <stdint.h>
 
 extern const  int gLowPrimes[10];
@@ -26,3 +29,27 @@ extern uint8_t gPrimesMask[];
 bool isprime(int64_t n);
 
 int64_t nextPrime(int64_t x);
+
+// segmented sieve over the mod 30 wheel. produces the primes in order, a segment at a time.
+// the sieving primes come from gPrimesMask, which is enough for every prime below kPrimeSieveLimit.
+
+const int kPrimeSieveSegmentSize = 32768; // bytes, each covering 30 numbers.
+const int64_t kPrimeSieveLimit = 1000000000000LL;
+
+class PrimeSieve
+{
+	int64_t mSegByte;
+	int mByte;
+	int mBits;
+	int mLow;
+	uint8_t mSeg[kPrimeSieveSegmentSize];
+	
+	void sieveSegment();
+public:
+	PrimeSieve();
+	
+	// writes up to n primes to out. returns fewer than n only once the primes below kPrimeSieveLimit are used up.
+	int next(int n, int64_t* out);
+};
+
+#endif
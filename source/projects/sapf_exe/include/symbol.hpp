@@ -18,8 +18,16 @@
 #define __symbol_h__
 
 #include "Object.hpp"
+#include <string_view>
 
 P<String> getsym(const char* name);
 
+// hash must be Hash(name.data(), name.size()). for callers that have already hashed the name,
+// such as the parser, which passes words in place in the source text.
+P<String> getsym(std::string_view name, int32_t hash);
+
+// returns the symbol for name if it has already been interned, otherwise null. never adds a symbol.
+P<String> findsym(const char* name);
+
 #endif
 
@@ -0,0 +1,488 @@
+//    SAPF - Sound As Pure Form
+//    Copyright (C) 2019 James McCartney
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "Bytecode.hpp"
+#include "Opcode.hpp"
+#include "symbol.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// value tags. reals are stored as their raw bits, which also covers the integer operands
+// of opcodes such as opPushLocalVar and opEach.
+enum {
+	kTagReal,
+	kTagNone,		// no object, for a FunDef without help.
+	kTagSymbol,		// u32 symbol table index
+	kTagString,		// u32 length, bytes
+	kTagBuiltin,	// u32 symbol table index of the builtin's name
+	kTagNilV,
+	kTagNilZ,
+	kTagZList,		// u64 length, doubles
+	kTagVList,		// u64 length, values
+	kTagTableMap,	// u32 size, key values
+	kTagCode,		// u32 opcode count, (u8 op, value) pairs, u32 key count, key values
+	kTagFunDef		// u16 args, locals, vars, leaves, u32 arg name count, names, help, code
+};
+
+class BytecodeWriter
+{
+	Thread& th;
+	std::string mBody;
+	std::vector<String*> mSymbols;
+	std::unordered_map<String*, uint32_t> mSymbolIndex;
+	std::unordered_map<Object*, String*> mBuiltinNames;
+
+	template <typename T>
+	void put(T x) { mBody.append((const char*)&x, sizeof(T)); }
+
+	void putSymbol(String* sym)
+	{
+		auto found = mSymbolIndex.find(sym);
+		if (found != mSymbolIndex.end()) {
+			put<uint32_t>(found->second);
+		} else {
+			uint32_t index = (uint32_t)mSymbols.size();
+			mSymbols.push_back(sym);
+			mSymbolIndex[sym] = index;
+			put<uint32_t>(index);
+		}
+	}
+
+	void putCode(Code* code)
+	{
+		put<uint8_t>(kTagCode);
+		put<uint32_t>((uint32_t)code->ops.size());
+		for (Opcode& opc : code->ops) {
+			put<uint8_t>((uint8_t)opc.op);
+			putValue(opc.v);
+		}
+		put<uint32_t>((uint32_t)code->keys.size());
+		for (Arg key : code->keys) putValue(key);
+	}
+
+	void putFunDef(FunDef* def)
+	{
+		put<uint8_t>(kTagFunDef);
+		put<uint16_t>(def->mNumArgs);
+		put<uint16_t>(def->mNumLocals);
+		put<uint16_t>(def->mNumVars);
+		put<uint16_t>(def->mLeaves);
+		put<uint32_t>((uint32_t)def->mArgNames.size());
+		for (P<String> const& name : def->mArgNames) putValue(name);
+		if (def->mHelp()) putValue(def->mHelp);
+		else put<uint8_t>(kTagNone);
+		putCode(def->mCode());
+	}
+
+public:
+	BytecodeWriter(Thread& inThread) : th(inThread)
+	{
+		// constant lists and forms defined as builtins are written by name, not by value.
+		for (P<TreeNode> const& node : vm.builtins->sorted()) {
+			if (node->mValue.isObject() && node->mKey.isString())
+				mBuiltinNames[node->mValue.o()] = (String*)node->mKey.o();
+		}
+	}
+
+	void putValue(Arg v)
+	{
+		Object* o = v.o();
+		if (!o) {
+			put<uint8_t>(kTagReal);
+			put<double>(v.f);
+		} else if (o == vm._nilv()) {
+			put<uint8_t>(kTagNilV);
+		} else if (o == vm._nilz()) {
+			put<uint8_t>(kTagNilZ);
+		} else if (o->isString()) {
+			String* s = (String*)o;
+			if (findsym(s->s)() == s) {
+				put<uint8_t>(kTagSymbol);
+				putSymbol(s);
+			} else {
+				size_t len = strlen(s->s);
+				put<uint8_t>(kTagString);
+				put<uint32_t>((uint32_t)len);
+				mBody.append(s->s, len);
+			}
+		} else if (auto found = mBuiltinNames.find(o); found != mBuiltinNames.end()) {
+			put<uint8_t>(kTagBuiltin);
+			putSymbol(found->second);
+		} else if (o->isPrim()) {
+			put<uint8_t>(kTagBuiltin);
+			putSymbol(getsym(((Prim*)o)->mName)());
+		} else if (o->isList()) {
+			List* list = (List*)o;
+			if (!list->isPacked()) {
+				post("bytecode: cannot save an unpacked list.\n");
+				throw errFailed;
+			}
+			Array* a = list->mArray();
+			put<uint8_t>(a->isZ() ? kTagZList : kTagVList);
+			put<uint64_t>((uint64_t)a->size());
+			if (a->isZ()) {
+				mBody.append((const char*)a->z(), a->size() * sizeof(Z));
+			} else {
+				for (int64_t i = 0; i < a->size(); ++i) putValue(a->v()[i]);
+			}
+		} else if (o->isTableMap()) {
+			TableMap* tmap = (TableMap*)o;
+			put<uint8_t>(kTagTableMap);
+			put<uint32_t>((uint32_t)tmap->mSize);
+			for (size_t i = 0; i < tmap->mSize; ++i) putValue(tmap->mKeys[i]);
+		} else if (Code* code = dynamic_cast<Code*>(o)) {
+			putCode(code);
+		} else if (FunDef* def = dynamic_cast<FunDef*>(o)) {
+			putFunDef(def);
+		} else {
+			post("bytecode: cannot save a %s.\n", o->TypeName());
+			throw errFailed;
+		}
+	}
+
+	void finish(std::string& out)
+	{
+		std::string symbols;
+		for (String* sym : mSymbols) {
+			uint32_t len = (uint32_t)strlen(sym->s);
+			symbols.append((const char*)&len, sizeof(len));
+			symbols.append(sym->s, len);
+		}
+
+		BytecodeHeader header;
+		header.magic = kBytecodeMagic;
+		header.version = kBytecodeVersion;
+		header.headerSize = sizeof(BytecodeHeader);
+		header.numSymbols = (uint32_t)mSymbols.size();
+		header.bodyOffset = (uint32_t)(sizeof(BytecodeHeader) + symbols.size());
+
+		out.clear();
+		out.reserve(header.bodyOffset + mBody.size());
+		out.append((const char*)&header, sizeof(header));
+		out.append(symbols);
+		out.append(mBody);
+	}
+};
+
+// values nested deeper than this are taken to be a corrupt file rather than recursed into.
+const int kMaxBytecodeDepth = 1000;
+
+class BytecodeReader
+{
+	Thread& th;
+	const uint8_t* p;
+	const uint8_t* end;
+	std::vector<P<String>> mSymbols;
+	int mDepth = 0;
+	// frame size of the FunDef whose code is being read, for checking operands.
+	uint16_t mNumLocals = 0;
+	uint16_t mNumVars = 0;
+
+	[[noreturn]] void bad(const char* msg)
+	{
+		post("bytecode: %s\n", msg);
+		throw errFailed;
+	}
+
+	void need(size_t n) { if ((size_t)(end - p) < n) bad("unexpected end of data."); }
+
+	// a count read from the file must fit in the rest of the data at minSize bytes per item.
+	void needItems(uint64_t count, size_t minSize)
+	{
+		if (count > (uint64_t)(end - p) / minSize) bad("unexpected end of data.");
+	}
+
+	template <typename T>
+	T get()
+	{
+		need(sizeof(T));
+		T x;
+		memcpy(&x, p, sizeof(T));
+		p += sizeof(T);
+		return x;
+	}
+
+	P<String> getSymbol()
+	{
+		uint32_t index = get<uint32_t>();
+		if (index >= mSymbols.size()) bad("bad symbol index.");
+		return mSymbols[index];
+	}
+
+	P<Code> getCode()
+	{
+		if (get<uint8_t>() != kTagCode) bad("expected code.");
+		uint32_t numOps = get<uint32_t>();
+		needItems(numOps, 2);
+		P<Code> code = new Code(numOps);
+		for (uint32_t i = 0; i < numOps; ++i) {
+			int op = get<uint8_t>();
+			if (op <= BAD_OPCODE || op >= kNumOpcodes) bad("bad opcode.");
+			V v = getValue();
+			checkOperand(op, v);
+			code->add(op, v);
+		}
+		uint32_t numKeys = get<uint32_t>();
+		needItems(numKeys, 1);
+		for (uint32_t i = 0; i < numKeys; ++i) code->keys.push_back(getValue());
+		if (!numOps || code->ops.back().op != opReturn) bad("code does not end in a return.");
+		return code;
+	}
+
+	// the interpreter indexes frames and dereferences operands without checks, so a file
+	// must not be able to reach past a frame or pass the wrong kind of object.
+	void checkOperand(int op, Arg v)
+	{
+		switch (op) {
+			case opPushLocalVar :
+			case opCallLocalVar :
+			case opBindLocal :
+			case opBindLocalFromList :
+				if (v.isObject() || v.i < 0 || v.i >= mNumLocals) bad("bad local variable index.");
+				break;
+			case opPushFunVar :
+			case opCallFunVar :
+				if (v.isObject() || v.i < 0 || v.i >= mNumVars) bad("bad function variable index.");
+				break;
+			case opPushWorkspaceVar :
+			case opCallWorkspaceVar :
+			case opBindWorkspaceVar :
+			case opBindWorkspaceVarFromList :
+			case opDot :
+			case opComma :
+				if (!v.isString()) bad("expected a name operand.");
+				break;
+			case opPushFun :
+				if (!dynamic_cast<FunDef*>(v.o())) bad("expected a function definition operand.");
+				break;
+			case opParens :
+			case opNewVList :
+			case opNewZList :
+			case opNewForm :
+			case opInherit :
+				if (!dynamic_cast<Code*>(v.o())) bad("expected a code operand.");
+				break;
+		}
+	}
+
+	P<FunDef> getFunDef()
+	{
+		uint16_t numArgs = get<uint16_t>();
+		uint16_t numLocals = get<uint16_t>();
+		uint16_t numVars = get<uint16_t>();
+		uint16_t leaves = get<uint16_t>();
+		if (numArgs > numLocals) bad("more arguments than locals.");
+		uint32_t numArgNames = get<uint32_t>();
+		if (numArgNames > numArgs) bad("more argument names than arguments.");
+		needItems(numArgNames, 1);
+		std::vector<P<String>> argNames(numArgNames);
+		for (P<String>& name : argNames) {
+			V v = getValue();
+			if (!v.isString()) bad("expected an argument name.");
+			name = (String*)v.o();
+		}
+		P<String> help;
+		need(1);
+		if (*p == kTagNone) {
+			++p;
+		} else {
+			V v = getValue();
+			if (!v.isString()) bad("expected a help string.");
+			help = (String*)v.o();
+		}
+
+		uint16_t outerLocals = mNumLocals;
+		uint16_t outerVars = mNumVars;
+		mNumLocals = numLocals;
+		mNumVars = numVars;
+		P<Code> code = getCode();
+		mNumLocals = outerLocals;
+		mNumVars = outerVars;
+
+		P<FunDef> def = new FunDef(th, code, numArgs, numLocals, numVars, help);
+		def->mLeaves = leaves;
+		def->mArgNames = std::move(argNames);
+		return def;
+	}
+
+public:
+	BytecodeReader(Thread& inThread, const uint8_t* data, size_t size) : th(inThread), p(data), end(data + size) {}
+
+	void readHeader()
+	{
+		const uint8_t* start = p;
+		BytecodeHeader header = get<BytecodeHeader>();
+		if (header.magic != kBytecodeMagic) bad("not a sapf bytecode file.");
+		if (header.version != kBytecodeVersion) {
+			post("bytecode: file is version %d. this build reads version %d.\n", header.version, kBytecodeVersion);
+			throw errFailed;
+		}
+		size_t size = end - start;
+		if (header.headerSize < sizeof(BytecodeHeader) || header.headerSize > size) bad("bad header size.");
+		if (header.bodyOffset < header.headerSize || header.bodyOffset > size) bad("bad body offset.");
+		p = start + header.headerSize;
+
+		// the fixup: every symbol index in the body resolves to an interned symbol.
+		needItems(header.numSymbols, sizeof(uint32_t));
+		mSymbols.resize(header.numSymbols);
+		for (P<String>& sym : mSymbols) {
+			uint32_t len = get<uint32_t>();
+			need(len);
+			sym = getsym(std::string_view((const char*)p, len), Hash((const char*)p, len));
+			p += len;
+		}
+		if (p != start + header.bodyOffset) bad("bad symbol table.");
+	}
+
+	V getValue()
+	{
+		if (++mDepth > kMaxBytecodeDepth) bad("values nested too deeply.");
+		V v = readValue();
+		--mDepth;
+		return v;
+	}
+
+	V readValue()
+	{
+		switch (get<uint8_t>()) {
+			case kTagReal : return get<double>();
+			case kTagSymbol : return getSymbol();
+			case kTagString : {
+				uint32_t len = get<uint32_t>();
+				need(len);
+				char* s = strndup((const char*)p, len);
+				p += len;
+				return new String(s, "");
+			}
+			case kTagBuiltin : {
+				P<String> name = getSymbol();
+				V value;
+				if (!vm.builtins->get(th, name, value)) {
+					post("bytecode: unknown builtin '%s'.\n", name->s);
+					throw errFailed;
+				}
+				return value;
+			}
+			case kTagNilV : return vm._nilv;
+			case kTagNilZ : return vm._nilz;
+			case kTagZList : {
+				uint64_t n = get<uint64_t>();
+				if (n > (uint64_t)(end - p) / sizeof(Z)) bad("unexpected end of data.");
+				P<List> list = new List(itemTypeZ, n);
+				memcpy(list->mArray->z(), p, n * sizeof(Z));
+				list->mArray->setSize(n);
+				p += n * sizeof(Z);
+				return list;
+			}
+			case kTagVList : {
+				uint64_t n = get<uint64_t>();
+				if (n > (uint64_t)(end - p)) bad("unexpected end of data.");
+				P<List> list = new List(itemTypeV, n);
+				for (uint64_t i = 0; i < n; ++i) list->add(getValue());
+				return list;
+			}
+			case kTagTableMap : {
+				uint32_t n = get<uint32_t>();
+				if (n > (uint64_t)(end - p)) bad("unexpected end of data.");
+				P<TableMap> tmap = new TableMap(n);
+				for (uint32_t i = 0; i < n; ++i) {
+					V key = getValue();
+					tmap->put(i, key, key.Hash());
+				}
+				return tmap;
+			}
+			case kTagCode : {
+				--p;
+				return getCode();
+			}
+			case kTagFunDef : return getFunDef();
+			default : bad("bad value tag.");
+		}
+	}
+
+	P<FunDef> getRoot()
+	{
+		if (get<uint8_t>() != kTagFunDef) bad("expected a function definition.");
+		P<FunDef> def = getFunDef();
+		if (p != end) bad("extra data after the code.");
+		return def;
+	}
+};
+
+void writeBytecode(Thread& th, P<FunDef> const& def, std::string& out)
+{
+	BytecodeWriter writer(th);
+	writer.putValue(def);
+	writer.finish(out);
+}
+
+P<FunDef> readBytecode(Thread& th, const uint8_t* data, size_t size)
+{
+	BytecodeReader reader(th, data, size);
+	reader.readHeader();
+	return reader.getRoot();
+}
+
+bool saveBytecodeFile(Thread& th, P<FunDef> const& def, const char* path)
+{
+	std::string bytes;
+	writeBytecode(th, def, bytes);
+
+	FILE* f = fopen(path, "wb");
+	if (!f) {
+		post("could not open '%s'\n", path);
+		return false;
+	}
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+	ok = fclose(f) == 0 && ok;
+	if (!ok) post("could not write '%s'\n", path);
+	return ok;
+}
+
+P<FunDef> loadBytecodeFile(Thread& th, const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		post("could not open '%s'\n", path);
+		throw errFailed;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		post("could not read '%s'\n", path);
+		throw errFailed;
+	}
+	size_t size = (size_t)st.st_size;
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		post("could not map '%s'\n", path);
+		throw errFailed;
+	}
+
+	P<FunDef> def;
+	try {
+		def = readBytecode(th, (const uint8_t*)data, size);
+	} catch (...) {
+		munmap(data, size);
+		throw;
+	}
+	munmap(data, size);
+	return def;
+}
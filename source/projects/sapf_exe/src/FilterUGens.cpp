@@ -3151,149 +3151,160 @@ static void decay2_(Thread& th, Prim* prim)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-struct Phase90A : public OneInputUGen<Phase90A>
+typedef Z Z2 __attribute__((vector_size(2 * sizeof(Z))));
+
+// the two allpass chains of the 90 degree phase difference network, filters by Olli Niemitalo.
+// the chains only differ in their coefficients, so they run side by side as the two lanes of a vector.
+struct Phase90Pair
+{
+	Z2 v1 = {0., 0.};
+	Z2 v2 = {0., 0.};
+	Z2 w1 = {0., 0.};
+	Z2 w2 = {0., 0.};
+	Z2 x1 = {0., 0.};
+	Z2 x2 = {0., 0.};
+	Z2 y1 = {0., 0.};
+	Z2 y2 = {0., 0.};
+	Z2 z1 = {0., 0.};
+	Z2 z2 = {0., 0.};
+	
+	// advances both chains by one sample and returns their outputs.
+	Z2 tick(Z in)
+	{
+		const Z2 c1 = { 0.47940086558884, 0.1617584983677 };  // sq(.6923878), sq(.4021921162426)
+		const Z2 c2 = { 0.87621849353931, 0.73302893234149 }; // sq(.9360654322959), sq(.8561710882420)
+		const Z2 c3 = { 0.9765975895082, 0.94534970032911 };  // sq(.9882295226860), sq(.9722909545651)
+		const Z2 c4 = { 0.99749925593555, 0.99059915668453 }; // sq(.9987488452737), sq(.9952884791278)
+		Z2 v0 = { in, in };
+		Z2 w0 = c1 * (v0 + w2) - v2;
+		Z2 x0 = c2 * (w0 + x2) - w2;
+		Z2 y0 = c3 * (x0 + y2) - x2;
+		Z2 z0 = c4 * (y0 + z2) - y2;
+		v2 = v1;
+		w2 = w1;
+		x2 = x1;
+		y2 = y1;
+		z2 = z1;
+		v1 = v0;
+		w1 = w0;
+		x1 = x0;
+		y1 = y0;
+		z1 = z0;
+		return z0;
+	}
+};
+
+struct HilbertOut;
+
+struct Hilbert : public Object
 {
-	// filters by Olli Niemitalo
-	constexpr static Z c1_ = 0.47940086558884; // sq(.6923878);
-	constexpr static Z c2_ = 0.87621849353931; // sq(.9360654322959);
-	constexpr static Z c3_ = 0.9765975895082;  // sq(.9882295226860);
-	constexpr static Z c4_ = 0.99749925593555; // sq(.9987488452737);
-	Z v1_ = 0.;
-	Z v2_ = 0.;
-	Z w1_ = 0.;
-	Z w2_ = 0.;
-	Z x1_ = 0.;
-	Z x2_ = 0.;
-	Z y1_ = 0.;
-	Z y2_ = 0.;
-	Z z1_ = 0.;
-	Z z2_ = 0.;
+	ZIn _in;
+	Phase90Pair _phase90;
 	
-	Phase90A(Thread& th, Arg in) : OneInputUGen<Phase90A>(th, in)
+	HilbertOut* mA;
+	HilbertOut* mB;
+		
+	Hilbert(Thread& th, Arg inIn) : _in(inIn)
 	{
+		finite = inIn.isFinite();
 	}
+
+	P<List> createOutputs(Thread& th);
+
+	virtual const char* TypeName() const override { return "Hilbert"; }
+
+	virtual void pull(Thread& th);
+};
+
+struct HilbertOut : public Gen
+{
+	P<Hilbert> mHilbert;
 	
-	virtual const char* TypeName() const override { return "Phase90A"; }
+	HilbertOut(Thread& th, bool inFinite, P<Hilbert> const& inHilbert) : Gen(th, itemTypeZ, inFinite), mHilbert(inHilbert)
+	{
+	}
+
+	virtual void norefs() override
+	{
+		mOut = nullptr;
+		mHilbert = nullptr;
+	}
 	
-	void calc(int n, Z* out, Z* in, int inStride)
+	virtual const char* TypeName() const override { return "HilbertOut"; }
+	
+	virtual void pull(Thread& th) override
 	{
-		Z c1 = c1_;
-		Z c2 = c2_;
-		Z c3 = c3_;
-		Z c4 = c4_;
-		
-		Z v1 = v1_;
-		Z v2 = v2_;
-		Z w1 = w1_;
-		Z w2 = w2_;
-		Z x1 = x1_;
-		Z x2 = x2_;
-		Z y1 = y1_;
-		Z y2 = y2_;
-		Z z1 = z1_;
-		Z z2 = z2_;
-		for (int i = 0; i < n; ++i) {
-			Z v0 = *in; in += inStride;
-			Z w0 = c1 * (v0 + w2) - v2;
-			Z x0 = c2 * (w0 + x2) - w2;
-			Z y0 = c3 * (x0 + y2) - x2;
-			Z z0 = c4 * (y0 + z2) - y2;
-			out[i] = z1;
-			v2 = v1;
-			w2 = w1;
-			x2 = x1;
-			y2 = y1;
-			z2 = z1;
-			v1 = v0;
-			w1 = w0;
-			x1 = x0;
-			y1 = y0;
-			z1 = z0;
-		}
-		v1_ = v1;
-		v2_ = v2;
-		w1_ = w1;
-		w2_ = w2;
-		x1_ = x1;
-		x2_ = x2;
-		y1_ = y1;
-		y2_ = y2;
-		z1_ = z1;
-		z2_ = z2;
+		mHilbert->pull(th);
 	}
+	
 };
 
-struct Phase90B : public OneInputUGen<Phase90B>
+void Hilbert::pull(Thread& th)
 {
-	// filters by Olli Niemitalo
-	constexpr static Z c1_ = 0.1617584983677;  // sc_squared(.4021921162426);
-	constexpr static Z c2_ = 0.73302893234149; // sc_squared(.8561710882420);
-	constexpr static Z c3_ = 0.94534970032911; // sc_squared(.9722909545651);
-	constexpr static Z c4_ = 0.99059915668453; // sc_squared(.9952884791278);
-	Z v1_ = 0.;
-	Z v2_ = 0.;
-	Z w1_ = 0.;
-	Z w2_ = 0.;
-	Z x1_ = 0.;
-	Z x2_ = 0.;
-	Z y1_ = 0.;
-	Z y2_ = 0.;
-	Z z1_ = 0.;
-	Z z2_ = 0.;
+	int framesToFill = mA->mBlockSize;
 	
-	Phase90B(Thread& th, Arg in) : OneInputUGen<Phase90B>(th, in)
-	{
+	Z Sink = 0.;
+	Z* Aout;
+	Z* Bout;
+	int Aoutstride = 1;
+	int Boutstride = 1;
+
+	if (mA->mOut) {
+		Aout = mA->mOut->fulfillz(framesToFill);
+	} else {
+		Aout = &Sink;
+		Aoutstride = 0;
+	}
+
+	if (mB->mOut) {
+		Bout = mB->mOut->fulfillz(framesToFill);
+	} else {
+		Bout = &Sink;
+		Boutstride = 0;
 	}
 	
-	virtual const char* TypeName() const override { return "Phase90B"; }
-	
-	void calc(int n, Z* out, Z* in, int inStride)
-	{
-		Z c1 = c1_;
-		Z c2 = c2_;
-		Z c3 = c3_;
-		Z c4 = c4_;
-		
-		Z v1 = v1_;
-		Z v2 = v2_;
-		Z w1 = w1_;
-		Z w2 = w2_;
-		Z x1 = x1_;
-		Z x2 = x2_;
-		Z y1 = y1_;
-		Z y2 = y2_;
-		Z z1 = z1_;
-		Z z2 = z2_;
+	Phase90Pair phase90 = _phase90; // a local copy stays in registers.
+	while (framesToFill) {
+		Z *a;
+		int n, aStride;
+		n = framesToFill;
+		if (_in(th, n, aStride, a)) {
+			mA->setDone();
+			mB->setDone();
+			break;
+		}
+		
 		for (int i = 0; i < n; ++i) {
-			Z v0 = *in; in += inStride;
-			Z w0 = c1 * (v0 + w2) - v2;
-			Z x0 = c2 * (w0 + x2) - w2;
-			Z y0 = c3 * (x0 + y2) - x2;
-			Z z0 = c4 * (y0 + z2) - y2;
-			out[i] = z0;
-			v2 = v1;
-			w2 = w1;
-			x2 = x1;
-			y2 = y1;
-			z2 = z1;
-			v1 = v0;
-			w1 = w0;
-			x1 = x0;
-			y1 = y0;
-			z1 = z0;
+			// the first output is delayed by a sample.
+			*Aout = phase90.z1[0];
+			*Bout = phase90.tick(*a)[1];
+			a += aStride;
+			Aout += Aoutstride;
+			Bout += Boutstride;
 		}
-		v1_ = v1;
-		v2_ = v2;
-		w1_ = w1;
-		w2_ = w2;
-		x1_ = x1;
-		x2_ = x2;
-		y1_ = y1;
-		y2_ = y2;
-		z1_ = z1;
-		z2_ = z2;
+		framesToFill -= n;
+		_in.advance(n);
 	}
-};
+	_phase90 = phase90;
+	if (mA->mOut) mA->produce(framesToFill);
+	if (mB->mOut) mB->produce(framesToFill);
+}
+
+P<List> Hilbert::createOutputs(Thread& th)
+{
+	mA = new HilbertOut(th, finite, this);
+	mB = new HilbertOut(th, finite, this);
+	
+	P<Gen> a = mA;
+	P<Gen> b = mB;
+	
+	P<List> s = new List(itemTypeV, 2);
+	P<Array> arr = s->mArray;
+	arr->add(new List(a));
+	arr->add(new List(b));
+	
+	return s;
+}
 
 struct AmpFollow : public OneInputUGen<AmpFollow>
 {
@@ -3302,36 +3313,7 @@ struct AmpFollow : public OneInputUGen<AmpFollow>
 	Z _lagmul;
 	bool once;
 
-	// filters by Olli Niemitalo
-	constexpr static Z c1a_ = 0.47940086558884; // sq(.6923878);
-	constexpr static Z c2a_ = 0.87621849353931; // sq(.9360654322959);
-	constexpr static Z c3a_ = 0.9765975895082;  // sq(.9882295226860);
-	constexpr static Z c4a_ = 0.99749925593555; // sq(.9987488452737);
-	Z v1a_ = 0.;
-	Z v2a_ = 0.;
-	Z w1a_ = 0.;
-	Z w2a_ = 0.;
-	Z x1a_ = 0.;
-	Z x2a_ = 0.;
-	Z y1a_ = 0.;
-	Z y2a_ = 0.;
-	Z z1a_ = 0.;
-	Z z2a_ = 0.;
-
-	constexpr static Z c1b_ = 0.1617584983677;  // sc_squared(.4021921162426);
-	constexpr static Z c2b_ = 0.73302893234149; // sc_squared(.8561710882420);
-	constexpr static Z c3b_ = 0.94534970032911; // sc_squared(.9722909545651);
-	constexpr static Z c4b_ = 0.99059915668453; // sc_squared(.9952884791278);
-	Z v1b_ = 0.;
-	Z v2b_ = 0.;
-	Z w1b_ = 0.;
-	Z w2b_ = 0.;
-	Z x1b_ = 0.;
-	Z x2b_ = 0.;
-	Z y1b_ = 0.;
-	Z y2b_ = 0.;
-	Z z1b_ = 0.;
-	Z z2b_ = 0.;
+	Phase90Pair phase90_;
 
 	Z b1r_;
 	Z b1f_;
@@ -3351,104 +3333,22 @@ struct AmpFollow : public OneInputUGen<AmpFollow>
 	
 	void calc(int n, Z* out, Z* in, int inStride)
 	{
-		Z c1a = c1a_;
-		Z c2a = c2a_;
-		Z c3a = c3a_;
-		Z c4a = c4a_;
-		
-		Z v1a = v1a_;
-		Z v2a = v2a_;
-		Z w1a = w1a_;
-		Z w2a = w2a_;
-		Z x1a = x1a_;
-		Z x2a = x2a_;
-		Z y1a = y1a_;
-		Z y2a = y2a_;
-		Z z1a = z1a_;
-		Z z2a = z2a_;
-
-		Z c1b = c1b_;
-		Z c2b = c2b_;
-		Z c3b = c3b_;
-		Z c4b = c4b_;
-		
-		Z v1b = v1b_;
-		Z v2b = v2b_;
-		Z w1b = w1b_;
-		Z w2b = w2b_;
-		Z x1b = x1b_;
-		Z x2b = x2b_;
-		Z y1b = y1b_;
-		Z y2b = y2b_;
-		Z z1b = z1b_;
-		Z z2b = z2b_;
+		Phase90Pair phase90 = phase90_;
 		
 		Z l1a = l1a_;
 		Z l1b = l1b_;
 
 		for (int i = 0; i < n; ++i) {
 			Z v0 = *in; in += inStride;
-			{
-				Z w0 = c1a * (v0 + w2a) - v2a;
-				Z x0 = c2a * (w0 + x2a) - w2a;
-				Z y0 = c3a * (x0 + y2a) - x2a;
-				Z z0 = c4a * (y0 + z2a) - y2a;
-				v2a = v1a;
-				w2a = w1a;
-				x2a = x1a;
-				y2a = y1a;
-				z2a = z1a;
-				v1a = v0;
-				w1a = w0;
-				x1a = x0;
-				y1a = y0;
-				z1a = z0;
-			}
-
-			{
-				Z w0 = c1b * (v0 + w2b) - v2b;
-				Z x0 = c2b * (w0 + x2b) - w2b;
-				Z y0 = c3b * (x0 + y2b) - x2b;
-				Z z0 = c4b * (y0 + z2b) - y2b;
-				v2b = v1b;
-				w2b = w1b;
-				x2b = x1b;
-				y2b = y1b;
-				z2b = z1b;
-				v1b = v0;
-				w1b = w0;
-				x1b = x0;
-				y1b = y0;
-				z1b = z0;
-			}
+			Z2 z = phase90.tick(v0);
 			
-			Z l0a = hypot(z1a, z1b); // vectorize this
+			Z l0a = hypot(z[0], z[1]);
 
 			l1a = l0a + (l0a > l1a ? b1r_ : b1f_) * (l1a - l0a);
 			l1b = l1a + (l1a > l1b ? b1r_ : b1f_) * (l1b - l1a);
 			out[i] = l1b;
 		}
-		v1a_ = v1a;
-		v2a_ = v2a;
-		w1a_ = w1a;
-		w2a_ = w2a;
-		x1a_ = x1a;
-		x2a_ = x2a;
-		y1a_ = y1a;
-		y2a_ = y2a;
-		z1a_ = z1a;
-		z2a_ = z2a;
-
-		v1b_ = v1b;
-		v2b_ = v2b;
-		w1b_ = w1b;
-		w2b_ = w2b;
-		x1b_ = x1b;
-		x2b_ = x2b;
-		y1b_ = y1b;
-		y2b_ = y2b;
-		z1b_ = z1b;
-		z2b_ = z2b;
+		phase90_ = phase90;
 		
 		l1a_ = l1a;
 		l1b_ = l1b;
@@ -3459,8 +3359,10 @@ static void hilbert_(Thread& th, Prim* prim)
 {
 	V in   = th.popZIn("hilbert : in");
 	
-	th.push(new List(new Phase90A(th, in)));
-	th.push(new List(new Phase90B(th, in)));
+	P<Hilbert> hilbert = new Hilbert(th, in);
+	P<List> outs = hilbert->createOutputs(th);
+	th.push(outs->mArray->at(0));
+	th.push(outs->mArray->at(1));
 }
 
 static void ampf_(Thread& th, Prim* prim)
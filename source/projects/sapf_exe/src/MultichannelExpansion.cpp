@@ -398,6 +398,123 @@ public:
 	}	
 };
 
+// EachMapper for a single level of iteration, which is what @ alone produces. The mask is
+// resolved once here into the iterated args and the constant ones, and the iterated lists are
+// read a segment at a time. stream generators normally produce one item per pull, so effects
+// and errors happen in the order the items are asked for. a pure prim applied to numbers has
+// neither, so for it the items already computed in the input segments are mapped together, up
+// to kEachPrimBlockSize.
+const int kEachPrimBlockSize = 64;
+
+class EachMapper1 : public Gen
+{
+	V fun;
+	Prim* prim;               // fun, when it is a pure prim taking exactly these args
+	int numArgs;
+	int numIters;
+	int iterArg[kMaxArgs];    // index of each iterated arg
+	BothIn iters[kMaxArgs];
+	V argv[kMaxArgs];         // values of the constant args
+public:
+	
+	EachMapper1(Thread& th, bool inFinite, int inNumArgs, V* inArgv, uint32_t* inMasks, Arg inFun)
+		: Gen(th, itemTypeV, inFinite), fun(inFun), prim(nullptr), numArgs(inNumArgs), numIters(0)
+	{
+		bool constantEachOps = false;
+		for (int j = 0; j < numArgs; ++j) {
+			if ((inMasks[j] & 1) && inArgv[j].isList()) {
+				iterArg[numIters] = j;
+				iters[numIters].set(inArgv[j]);
+				++numIters;
+			} else {
+				argv[j] = inArgv[j];
+				if (argv[j].isEachOp()) constantEachOps = true;
+			}
+		}
+		if (fun.isPrim() && fun.o()->IsPure() && ((Prim*)fun.o())->mTakes == numArgs && !constantEachOps) {
+			prim = (Prim*)fun.o();
+			mBlockSize = std::max(mBlockSize, kEachPrimBlockSize);
+		}
+	}
+	
+	const char* TypeName() const override { return "EachMapper1"; }
+	
+	// make the current segment of an iterated list non empty. returns true at the end of the list.
+	static bool segment(Thread& th, BothIn& in, int64_t& outAvailable)
+	{
+		while (in.mList) {
+			if (in.mOffset == 0)
+				in.mList->force(th);
+			int64_t size = in.mList->mArray->size();
+			if (in.mOffset < size) {
+				outAvailable = size - in.mOffset;
+				return false;
+			}
+			in.mList = in.mList->next();
+			in.mOffset = 0;
+		}
+		in.mDone = true;
+		return true;
+	}
+	
+	void pull(Thread& th) override
+	{
+		// take no more than every iterated input has in its current segment.
+		int64_t n = mBlockSize;
+		const V* vp[kMaxArgs];
+		const Z* zp[kMaxArgs];
+		bool allZ = true;
+		for (int k = 0; k < numIters; ++k) {
+			int64_t available;
+			if (segment(th, iters[k], available)) {
+				end();
+				return;
+			}
+			n = std::min(n, available);
+			Array* a = iters[k].mList->mArray();
+			vp[k] = a->isV() ? a->v() + iters[k].mOffset : nullptr;
+			zp[k] = a->isZ() ? a->z() + iters[k].mOffset : nullptr;
+			if (vp[k]) allZ = false;
+		}
+		
+		// numbers can't be each ops, so with signal inputs the prim can be called directly.
+		Prim* direct = allZ ? prim : nullptr;
+		if (!direct) n = std::min(n, (int64_t)vm.VblockSize);
+		
+		int framesToFill = (int)n;
+		V* out = mOut->fulfill(framesToFill);
+		for (int64_t i = 0; i < n; ++i) {
+			SaveStack ss(th);
+			for (int k = 0; k < numIters; ++k) {
+				argv[iterArg[k]] = vp[k] ? vp[k][i] : V(zp[k][i]);
+			}
+			for (int j = 0; j < numArgs; ++j) {
+				th.push(argv[j]);
+			}
+			try {
+				if (direct) direct->prim(th, direct);
+				else fun.apply(th);
+			} catch (...) {
+				setDone();
+				produce(framesToFill);
+				throw;
+			}
+			out[i] = th.pop();
+			--framesToFill;
+		}
+		
+		for (int k = 0; k < numIters; ++k) {
+			BothIn& in = iters[k];
+			in.mOffset += (int)n;
+			if (in.mOffset == in.mList->mArray->size()) {
+				in.mList = in.mList->next();
+				in.mOffset = 0;
+			}
+		}
+		produce(framesToFill);
+	}	
+};
+
 List* handleEachOps(Thread& th, int numArgs, Arg fun)
 {
 	ArgInfo args;
@@ -434,6 +551,19 @@ List* handleEachOps(Thread& th, int numArgs, Arg fun)
 	}
 	
 	int numLevels = maxMask <= 1 ? 1 : LOG2CEIL(maxMask);
+	if (numLevels == 1) {
+		V iterv[kMaxArgs];
+		uint32_t masks[kMaxArgs];
+		bool anyList = false;
+		for (int i = 0; i < numArgs; ++i) {
+			masks[i] = args.arg[i].mask;
+			iterv[i] = argv[i].isEachOp() ? ((EachOp*)argv[i].o())->v : argv[i];
+			if ((masks[i] & 1) && iterv[i].isList())
+				anyList = true;
+		}
+		if (anyList)
+			return new List(new EachMapper1(th, mmIsFinite, numArgs, iterv, masks, fun));
+	}
 	return new List(new EachMapper(th, mmIsFinite, numLevels-1, numLevels, args, fun));
 }
 
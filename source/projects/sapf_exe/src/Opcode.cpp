@@ -149,7 +149,11 @@ void Thread::run(Opcode* opc)
 
 				case opDot : {
 					V ioValue;
-					if (!pop().dot(th, v, ioValue))
+					V receiver = pop();
+					bool found = receiver.isForm()
+						? ((Form*)receiver.o())->dotCached(th, v, opc->cache, ioValue)
+						: receiver.dot(th, v, ioValue);
+					if (!found)
 						notFound(v);
 					push(ioValue);
 					break;
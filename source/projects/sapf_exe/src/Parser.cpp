@@ -19,6 +19,8 @@
 #include <ctype.h>
 #include <cmath>
 #include <vector>
+#include <charconv>
+#include <string_view>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -44,134 +46,192 @@ public:
 };
 
 
-static bool skipSpace(Thread& th)
+// character classes for the scanner, so each character costs one table lookup.
+enum {
+	kCharSpace = 1,		// skipped between elements: white space and control characters.
+	kCharEndOfWord = 2,	// ends a word: nul, white space and the non name characters.
+	kCharDigit = 4
+};
+
+const char* nonnamechars = ";()[]{}.`,:\"\n";
+
+struct CharClasses
 {
-	//ScopeLog sl("skipSpace");
-	for (;;) {
-		int c = th.getc();
-		if (c == ';') {
-			c = th.getc();
-			while (c && c != '\n') { c = th.getc(); }
-			if (c == 0) { th.unget(1); return true; }
-		}
-		if (c == 0) { th.unget(1); return true; }
-		bool skip = isspace(c) || iscntrl(c);
-		if (!skip) { th.unget(1); break; }
+	uint8_t mClass[256] = {};
+	
+	constexpr CharClasses()
+	{
+		for (int c = 1; c <= ' '; ++c) mClass[c] |= kCharSpace;
+		mClass[127] |= kCharSpace;
+		mClass[0] |= kCharEndOfWord;
+		for (int c = '\t'; c <= '\r'; ++c) mClass[c] |= kCharEndOfWord;
+		mClass[' '] |= kCharEndOfWord;
+		for (const char* s = ";()[]{}.`,:\"\n"; *s; ++s) mClass[(uint8_t)*s] |= kCharEndOfWord;
+		for (int c = '0'; c <= '9'; ++c) mClass[c] |= kCharDigit;
 	}
-	return false;
-}
+};
 
-const char* nonnamechars = ";()[]{}.`,:\"\n";
+static constexpr CharClasses sCharClasses;
+
+static inline bool charIs(int c, int charClass)
+{
+	return sCharClasses.mClass[(uint8_t)c] & charClass;
+}
 
 static bool endOfWord(int c)
 {
-	return c == 0 || isspace(c) || strchr(nonnamechars, c) != nullptr;
+	return charIs(c, kCharEndOfWord);
+}
+
+static const char* scanWord(const char* s)
+{
+	while (!endOfWord(*s)) ++s;
+	return s;
+}
+
+static const char* scanDigits(const char* s)
+{
+	while (charIs(*s, kCharDigit)) ++s;
+	return s;
+}
+
+// reports a syntax error with its line and column in the source being parsed.
+[[noreturn]] static void parseError(Thread& th, const char* msg, const char* where = nullptr)
+{
+	if (!th.line) {
+		th.errorLine = th.errorColumn = 0;
+		post("syntax error: %s\n", msg);
+		throw errSyntax;
+	}
+	if (!where) where = th.curline();
+	// getc steps past the terminating nul when reading from a string.
+	const char* lineEnd = th.line + strlen(th.line);
+	if (where > lineEnd) where = lineEnd;
+	int lineNum = 1;
+	const char* lineStart = th.line;
+	for (const char* s = th.line; s < where; ++s) {
+		if (*s == '\n') {
+			++lineNum;
+			lineStart = s + 1;
+		}
+	}
+	th.errorLine = lineNum;
+	th.errorColumn = (int)(where - lineStart) + 1;
+	post("syntax error at line %d, column %d: %s\n", th.errorLine, th.errorColumn, msg);
+	throw errSyntax;
+}
+
+static bool skipSpace(Thread& th)
+{
+	//ScopeLog sl("skipSpace");
+	for (;;) {
+		if (th.line) {
+			// scan the buffer directly, up to the end of the current line.
+			const char* s = th.curline();
+			for (;;) {
+				if (*s == ';') {
+					while (*s && *s != '\n') ++s;
+				} else if (charIs(*s, kCharSpace)) {
+					++s;
+				} else break;
+			}
+			th.advance(s);
+			if (*s) return false;
+		}
+		// end of the line. getc reads the next one when inside brackets at the repl.
+		int c = th.getc();
+		th.unget(1);
+		if (c == 0) return true;
+	}
 }
 
 static bool parseHexNumber(Thread& th, P<Code>& code)
 {
-	const char* start = th.curline();
+	const char* s = th.curline() + 2;
 	int64_t z = 0;
 	
-	th.getc();
-	th.getc();
-	int c = th.getc();
-	while(isxdigit(c)) {
-		if (isdigit(c)) z = z*16 + c - '0';
-		else z = z*16 + toupper(c) - 'A' + 10;
-		c = th.getc();
+	while(isxdigit(*s)) {
+		if (charIs(*s, kCharDigit)) z = z*16 + *s - '0';
+		else z = z*16 + toupper(*s) - 'A' + 10;
+		++s;
 	}
 
-	if (!endOfWord(c)) {
+	if (!endOfWord(*s)) {
 		// even though it starts out like a number it continues as some other token
-		th.unget(start);
 		return false;
-	} else {
-		th.unget(1);
 	}
+	th.advance(s);
 	
 	code->add(opPushImmediate, z);
 	
 	return true;
 }
 
+// converts the number text in [start, end).
+static double toDouble(Thread& th, const char* start, const char* end)
+{
+	if (*start == '+') ++start;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+	double x;
+	std::from_chars_result r = std::from_chars(start, end, x);
+	if (r.ec == std::errc()) return x;
+#endif
+	// out of range, or no floating point from_chars in this library.
+	th.toToken(start, (int)(end - start));
+	return strtod(th.token, nullptr);
+}
 
 static bool parseFloat(Thread& th, Z& result)
 {	
 	//ScopeLog sl("parseFloat");
 	const char* start = th.curline();
-	int c = th.getc();
+	const char* s = start;
     
-    if (c == 'p' && th.c() == 'i') {
-        th.getc();
+    if (s[0] == 'p' && s[1] == 'i') {
+        th.advance(s + 2);
         result = M_PI;
         return true;
     }
     
-	if (c == '+' || c == '-') 
-		c = th.getc();
-
-	int digits = 0;
-	bool sawdot = false;
-	for ( ; ; ) {
-		if (isdigit(c)) digits++;
-		else if (c == '.') {
-			if (sawdot) break;
-			sawdot = true; 
-		}
-		else break;
-		c = th.getc(); 
-	}
-	if (digits == 0) {
-		th.unget(start);
+	if (*s == '+' || *s == '-') 
+		++s;
+
+	const char* digits = s;
+	s = scanDigits(s);
+	bool sawdigits = s > digits;
+	if (*s == '.') {
+		const char* fraction = ++s;
+		s = scanDigits(s);
+		sawdigits = sawdigits || s > fraction;
+	}
+	if (!sawdigits) {
 		return false;
 	}
 	
-	if (c == 'e' || c == 'E') {
-		c = th.getc();
-		if (c == '+' || c == '-') 
-			c = th.getc();
-		while (isdigit(c)) { c = th.getc(); }
-	}
-
-	th.toToken(start, (int)(th.curline() - start));
-	
-	bool sawpi = false;
-	bool sawmega = false;
-	bool sawkilo = false;
-	bool sawhecto = false;
-	bool sawcenti = false;
-	bool sawmilli = false;
-	bool sawmicro = false;
-	
-	
-	if (c == 'p' && th.c() == 'i') {
-		sawpi = true;
-		th.getc();
-	} else if (c == 'M') {
-		sawmega = true;
-	} else if (c == 'k') {
-		sawkilo = true;
-	} else if (c == 'h') {
-		sawhecto = true;
-	} else if (c == 'c') {
-		sawcenti = true;
-	} else if (c == 'm') {
-		sawmilli = true;
-	} else if (c == 'u') {
-		sawmicro = true;
-	} else {
-		th.unget(1);
+	if (*s == 'e' || *s == 'E') {
+		++s;
+		if (*s == '+' || *s == '-') 
+			++s;
+		s = scanDigits(s);
 	}
 
-	double x = strtod(th.token, nullptr);
-	if (sawpi) x *= M_PI;
-	else if (sawmega) x *= 1e6;
-	else if (sawkilo) x *= 1e3;
-	else if (sawhecto) x *= 1e2;
-	else if (sawcenti) x *= 1e-2;
-	else if (sawmilli) x *= 1e-3;
-	else if (sawmicro) x *= 1e-6;
+	double x = toDouble(th, start, s);
+	
+	// an optional scale suffix.
+	if (s[0] == 'p' && s[1] == 'i') {
+		x *= M_PI;
+		s += 2;
+	} else {
+		switch (*s) {
+			case 'M' : x *= 1e6; ++s; break;
+			case 'k' : x *= 1e3; ++s; break;
+			case 'h' : x *= 1e2; ++s; break;
+			case 'c' : x *= 1e-2; ++s; break;
+			case 'm' : x *= 1e-3; ++s; break;
+			case 'u' : x *= 1e-6; ++s; break;
+		}
+	}
+	th.advance(s);
 
 	result = x;
 	return true;
@@ -218,7 +278,7 @@ static bool parseQuote(Thread& th, P<Code>& code)
 	P<String> name;
 
 	if (!parseSymbol(th, name)) 
-		syntaxError("expected symbol after quote");
+		parseError(th, "expected symbol after quote");
 	
 	V vname(name);
 	code->add(opPushImmediate, vname);
@@ -232,7 +292,7 @@ static bool parseBackquote(Thread& th, P<Code>& code)
 	P<String> name;
 
 	if (!parseSymbol(th, name)) 
-		syntaxError("expected symbol after backquote");
+		parseError(th, "expected symbol after backquote");
 
 
 	V vname(name);
@@ -256,7 +316,7 @@ static bool parseBackquote(Thread& th, P<Code>& code)
 			break;
 		default :
 			post("backquote error: \"%s\" is an undefined word\n", name->s);
-			syntaxError("undefined word");
+			parseError(th, "undefined word", th.curline() - strlen(name->s));
 	}
 
 	return true; 
@@ -268,7 +328,7 @@ static bool parseDot(Thread& th, P<Code>& code)
 	P<String> name;
 
 	if (!parseSymbol(th, name)) 
-		syntaxError("expected symbol after dot");
+		parseError(th, "expected symbol after dot");
 	
 	V vname(name);
 	code->add(opDot, vname);
@@ -282,7 +342,7 @@ static bool parseComma(Thread& th, P<Code>& code)
 	P<String> name;
 
 	if (!parseSymbol(th, name)) 
-		syntaxError("expected symbol after dot");
+		parseError(th, "expected symbol after dot");
 	
 	V vname(name);
 	code->add(opComma, vname);
@@ -297,7 +357,7 @@ static bool parseColon(Thread& th, P<Code>& code)
     P<String> name;
 
     if (!parseSymbol(th, name)) 
-        syntaxError("expected symbol after colon");
+        parseError(th, "expected symbol after colon");
     
     code->keys.push_back(name);
 
@@ -335,7 +395,7 @@ static bool parseEachOp(Thread& th, P<Code>& code)
 		mask = 1;
 	}
 	if (isdigit(c)) {
-		syntaxError("unexpected extra digit after @");
+		parseError(th, "unexpected extra digit after @");
 	}
 	
 	th.unget(1);
@@ -426,7 +486,7 @@ static bool parseLambda(Thread& th, P<Code>& code)
 		
 		int takes, leaves;
 		if (!parseStackEffect(th, takes, leaves)) {
-			syntaxError("incorrectly formatted function argument stack effect annotation.");
+			parseError(th, "incorrectly formatted function argument stack effect annotation.");
 		}
 		
 		LocalDef def;
@@ -446,7 +506,7 @@ static bool parseLambda(Thread& th, P<Code>& code)
 	int c = th.getc();	
 	if (c != '[') {
         post("got char '%c' %d\n", c, c);
-		syntaxError("expected open square bracket after argument list");
+		parseError(th, "expected open square bracket after argument list");
 	}
 		
 	P<Code> code2 = new Code(8);	
@@ -550,9 +610,9 @@ bool parseItemList(Thread& th, P<Code>& code, int endbrace)
 		int c = th.c();
 		if (c == endbrace) break;
 		if (!parseElem(th, code)) {
-			if (endbrace == ']') syntaxError("expected ']'");
-			if (endbrace == '}') syntaxError("expected '}'");
-			if (endbrace == ')') syntaxError("expected ')'");
+			if (endbrace == ']') parseError(th, "expected ']'");
+			if (endbrace == '}') parseError(th, "expected '}'");
+			if (endbrace == ')') parseError(th, "expected ')'");
 		}
 	}
 	th.getc(); // skip end brace
@@ -566,19 +626,14 @@ bool parseSymbol(Thread& th, P<String>& result)
 	//ScopeLog sl("parseSymbol");
 	skipSpace(th);
 	const char* start = th.curline();
-	int c = th.getc();
-	
-	while(!endOfWord(c)) {
-		c = th.getc();
-	}
-	th.unget(1);
+	const char* end = scanWord(start);
 
-	size_t len = th.curline() - start;
+	size_t len = end - start;
 	if (len == 0) return false;
-
-	th.toToken(start, (int)len);
+	th.advance(end);
 	
-	result = getsym(th.token);
+	std::string_view name(start, len);
+	result = getsym(name, Hash(start, len));
 
 	return true;
 }
@@ -636,14 +691,14 @@ bool parseWord(Thread& th, P<Code>& code)
 				}
 			}
 			if (names.size() == 0) {
-				syntaxError("expected a name after '= ('\n");
+				parseError(th, "expected a name after '= ('");
 			}
 			for (int64_t i = names.size()-1; i>=0; --i) {
 				bindVar(th, names[i], code);
 			}
 			skipSpace(th);
 			if (th.c() != ')') {
-				syntaxError("expected ')' after '= ('\n");
+				parseError(th, "expected ')' after '= ('");
 			}
 			th.getc();
 			code->add(opNone, 0.);
@@ -658,21 +713,21 @@ bool parseWord(Thread& th, P<Code>& code)
 				}
 			}
 			if (names.size() == 0) {
-				syntaxError("expected a name after '= ['\n");
+				parseError(th, "expected a name after '= ['");
 			}
 			for (size_t i = 0; i<names.size(); ++i) {
 				bindVarFromList(th, names[i], code);
 			}
 			skipSpace(th);
 			if (th.c() != ']') {
-				syntaxError("expected ']' after '= ['\n");
+				parseError(th, "expected ']' after '= ['");
 			}
 			th.getc();
 			code->add(opNone, 0.);
 		} else {
 			P<String> name2;
 			if (!parseSymbol(th, name2)) {
-				syntaxError("expected a name after '='\n");
+				parseError(th, "expected a name after '='");
 			}
 			bindVar(th, name2, code);
 		}
@@ -698,7 +753,7 @@ bool parseWord(Thread& th, P<Code>& code)
 				break;
 			default :
 				post("\"%s\" is an undefined word\n", name->cstr());
-				syntaxError("undefined word");
+				parseError(th, "undefined word", th.curline() - strlen(name->cstr()));
 				
 		}
 
@@ -729,7 +784,7 @@ static String* parseString(Thread& th)
 		
 	while (true) {
 		if (c == 0) {
-			syntaxError("end of input in string");
+			parseError(th, "end of input in string");
 		} else if (c == '\\' && th.c() == '\\') {
 			th.getc();
 			c = th.getc();
@@ -744,8 +799,9 @@ static String* parseString(Thread& th)
 			c = th.getc();
 		} else if (c == '"') {
 			if (th.c() == '"') {
-				c = th.getc();
+				th.getc();
 				str += '"';
+				c = th.getc();
 			} else {
 				break;
 			}
@@ -765,8 +821,9 @@ bool parseElem(Thread& th, P<Code>& code)
 	if (c == 0)
 		return false;
 	if (c == ']' || c == ')' || c == '}') {
-		post("unexpected '%c'.\n", c);
-		throw errSyntax;
+		char msg[32];
+		snprintf(msg, sizeof(msg), "unexpected '%c'.", c);
+		parseError(th, msg);
 	}
 	if (c == '@')
 		 return parseEachOp(th, code);
@@ -804,7 +861,7 @@ bool parseElem(Thread& th, P<Code>& code)
 
 	if (c == '#') {
 		int d = th.d();
-		if (!d) syntaxError("end of input after '#'");
+		if (!d) parseError(th, "end of input after '#'");
 		if (d == '[') {
 			return parseZArray(th, code);
 		} else {
@@ -16,22 +16,80 @@
 
 #include "VM.hpp"
 #include "clz.hpp"
+#include <algorithm>
+
+// Set is an open addressing table in the style of a swiss table.
+// Each slot has a control byte holding a 7 bit fragment of the item's hash, or kSetEmpty.
+// A probe reads a group of eight control bytes as one word and matches the fragment against all of them at once,
+// so Equals is only called for slots whose fragment and cached full hash both match.
+// The group match is done with plain 64 bit arithmetic, which works the same on arm64 and x86_64.
+// Items are kept in mPairs in insertion order. The slot table has twice as many slots as mPairs, so a group
+// with an empty slot is always found.
 
 struct SetPair
 {
 	V mValue;
 	int mIndex;
+	int mHash;
 };
 
+const int kSetGroupSize = 8;
+const uint8_t kSetEmpty = 0x80;
+const uint64_t kSetGroupLSBs = 0x0101010101010101ULL;
+const uint64_t kSetGroupMSBs = 0x8080808080808080ULL;
+
+static inline uint64_t setLoadGroup(const uint8_t* ctrl)
+{
+	uint64_t group;
+	memcpy(&group, ctrl, sizeof(group));
+	return group;
+}
+
+static inline uint64_t setMatchFragment(uint64_t group, uint8_t fragment)
+{
+	// may report a false positive for a full slot next to a true match. the cached hash check weeds those out.
+	uint64_t x = group ^ (kSetGroupLSBs * fragment);
+	return (x - kSetGroupLSBs) & ~x & kSetGroupMSBs;
+}
+
+static inline uint64_t setMatchEmpty(uint64_t group)
+{
+	return group & kSetGroupMSBs;
+}
+
+static inline int setSlotInGroup(uint64_t match)
+{
+	return __builtin_ctzll(match) >> 3;
+}
+
+static inline int hashz(Z z)
+{
+	// must agree with V::Hash for reals.
+	union {
+		double f;
+		uint64_t i;
+	} u;
+	u.f = z == 0. ? 0. : z;
+	return (int)::Hash64(u.i);
+}
+
 class Set : public Object
 {
 	int mSize;
 	int mCap;
-	int* mIndices;
+	int mGroupMask;
+	uint8_t* mCtrl;
+	int* mSlots;
 	SetPair* mPairs;
 	
-	void grow(Thread& th);
+	void grow();
 	void alloc(int cap);
+	void insert(int inSlot, Arg inValue, int inHash, int inIndex);
+	void rehash(int inPair);
+	
+	// returns the index of the pair matching inHash and pred, or -1 and the empty slot where the item belongs.
+	template <class Pred>
+	int lookup(int inHash, Pred pred, int& outSlot) const;
     
 	Set(const Set& that) {}
 public:
@@ -48,19 +106,53 @@ public:
 	
 	int size() { return mSize; }
 	
-	bool has(Thread& th, V& value);
+	bool has(Thread& th, V& value) { return has(th, value, value.Hash()); }
+	bool has(Thread& th, V& value, int hash);
     int indexOf(Thread& th, V& value);
 	
+	bool hasz(Z z);
+	int indexOfz(Z z);
+	
 	void put(Thread& th, V& inValue, int inIndex);
+	void putz(Z inValue, int inIndex);
     
     void putAll(Thread& th, P<List>& list);
 	
 	virtual V at(int64_t i) override { return mPairs[i].mValue; }
+	int hashAt(int64_t i) const { return mPairs[i].mHash; }
     
     P<List> asVList(Thread& th);
     P<List> asZList(Thread& th);
 };
 
+template <class Pred>
+inline int Set::lookup(int inHash, Pred pred, int& outSlot) const
+{
+	uint8_t fragment = inHash & 0x7f;
+	int groupMask = mGroupMask;
+	int group = (inHash >> 7) & groupMask;
+	const uint8_t* ctrl = mCtrl;
+	const int* slots = mSlots;
+	const SetPair* pairs = mPairs;
+	
+	// triangular probing visits every group because the group count is a power of two.
+	for (int step = 1; ; ++step) {
+		int base = group * kSetGroupSize;
+		uint64_t g = setLoadGroup(ctrl + base);
+		for (uint64_t match = setMatchFragment(g, fragment); match; match &= match - 1) {
+			int k = slots[base + setSlotInGroup(match)];
+			if (pairs[k].mHash == inHash && pred(pairs[k].mValue)) {
+				return k;
+			}
+		}
+		uint64_t empty = setMatchEmpty(g);
+		if (empty) {
+			outSlot = base + setSlotInGroup(empty);
+			return -1;
+		}
+		group = (group + step) & groupMask;
+	}
+}
 
 bool Set::Equals(Thread& th, Arg v) 
 {
@@ -71,79 +163,81 @@ bool Set::Equals(Thread& th, Arg v)
 	if (mSize != that->size()) return false;
     
 	for (int64_t i = 0; i < mSize; ++i) {
-		V& value = mPairs[i].mValue;
-		V u;
-		if (!that->has(th, value)) return false;
+		if (!that->has(th, mPairs[i].mValue, mPairs[i].mHash)) return false;
 	}
     
 	return true;
 }
 
-bool Set::has(Thread& th, V& value) 
+bool Set::has(Thread& th, V& value, int hash) 
 {	
-	int hash = value.Hash();
-	int mask = mCap * 2 - 1;
-	int index = hash & mask;
-	int* indices = mIndices;
-	SetPair* pairs = mPairs;
-	
-	while(1) {
-		int index2 = indices[index]-1;
-		if (index2 == -1) {
-			return false;
-		}
-		V& testVal = pairs[index2].mValue;
-		if (value.Equals(th, testVal)) {
-			return true;
-		}
-		index = (index + 1) & mask;
-	}	
-	
-	return false;
+	int slot;
+	return lookup(hash, [&](Arg testVal) { return value.Equals(th, testVal); }, slot) >= 0;
 }
 
 int Set::indexOf(Thread& th, V& value)
 {	
-	int hash = value.Hash();
-	int mask = mCap * 2 - 1;
-	int index = hash & mask;
-	int* indices = mIndices;
-	SetPair* pairs = mPairs;
-	
-	while(1) {
-		int index2 = indices[index]-1;
-		if (index2 == -1) {
-			return -1;
-		}
-		V& testVal = pairs[index2].mValue;
-		if (value.Equals(th, testVal)) {
-			return pairs[index2].mIndex;
-		}
-		index = (index + 1) & mask;
-	}	
-	
-	return -1;
+	int slot;
+	int k = lookup(value.Hash(), [&](Arg testVal) { return value.Equals(th, testVal); }, slot);
+	return k < 0 ? -1 : mPairs[k].mIndex;
 }
 
+bool Set::hasz(Z z)
+{
+	int slot;
+	return lookup(hashz(z), [z](Arg testVal) { return testVal.isReal() && testVal.f == z; }, slot) >= 0;
+}
+
+int Set::indexOfz(Z z)
+{
+	int slot;
+	int k = lookup(hashz(z), [z](Arg testVal) { return testVal.isReal() && testVal.f == z; }, slot);
+	return k < 0 ? -1 : mPairs[k].mIndex;
+}
 
 Set::~Set()
 {
 	delete [] mPairs;
-	free(mIndices);
+	free(mSlots);
+	free(mCtrl);
 }
 
 void Set::alloc(int cap)
 {
-	cap = NEXTPOWEROFTWO(cap);
+	cap = std::max(kSetGroupSize, NEXTPOWEROFTWO(cap));
+	int numSlots = 2 * cap;
 	mPairs = new SetPair[cap];
-	mIndices = (int*)calloc(2 * cap, sizeof(int));
+	mCtrl = (uint8_t*)malloc(numSlots);
+	memset(mCtrl, kSetEmpty, numSlots);
+	mSlots = (int*)calloc(numSlots, sizeof(int));
+	mGroupMask = numSlots / kSetGroupSize - 1;
 	mCap = cap;
 	mSize = 0;
 }
 
-void Set::grow(Thread& th)
+void Set::insert(int inSlot, Arg inValue, int inHash, int inIndex)
 {
-	free(mIndices);
+	int k = mSize++;
+	mCtrl[inSlot] = inHash & 0x7f;
+	mSlots[inSlot] = k;
+	mPairs[k].mValue = inValue;
+	mPairs[k].mIndex = inIndex;
+	mPairs[k].mHash = inHash;
+}
+
+void Set::rehash(int inPair)
+{
+	// items are already unique, so only an empty slot is needed. no Equals calls.
+	int slot;
+	lookup(mPairs[inPair].mHash, [](Arg) { return false; }, slot);
+	mCtrl[slot] = mPairs[inPair].mHash & 0x7f;
+	mSlots[slot] = inPair;
+}
+
+void Set::grow()
+{
+	free(mSlots);
+	free(mCtrl);
     
 	SetPair* oldPairs = mPairs;
 	int oldSize = mSize;
@@ -151,8 +245,11 @@ void Set::grow(Thread& th)
 	alloc(mCap * 2);
 	
 	for (int i = 0; i < oldSize; ++i) {
-		SetPair& pair = oldPairs[i];
-		put(th, pair.mValue, pair.mIndex);
+		mPairs[i] = oldPairs[i];
+	}
+	mSize = oldSize;
+	for (int i = 0; i < oldSize; ++i) {
+		rehash(i);
 	}
 	
 	delete [] oldPairs;
@@ -161,41 +258,46 @@ void Set::grow(Thread& th)
 void Set::put(Thread& th, V& inValue, int inIndex)
 {
 	if (mSize == mCap) {
-		grow(th);
+		grow();
 	}
     
 	int hash = inValue.Hash();
-	int mask = mCap * 2 - 1;
-	int index = hash & mask;
-	int* indices = mIndices;
-	SetPair* pairs = mPairs;
-    
-	while(1) {
-		int index2 = indices[index]-1;
-		if (index2 == -1) {
-			index2 = mSize++;
-			indices[index] = index2+1;
-			pairs[index2].mValue = inValue;
-			pairs[index2].mIndex = inIndex;
-			return;
-		}
-		V& testVal = pairs[index2].mValue;
-		if (inValue.Equals(th, testVal)) {
-			return;
-		}
-		index = (index + 1) & mask;
+	int slot;
+	if (lookup(hash, [&](Arg testVal) { return inValue.Equals(th, testVal); }, slot) < 0) {
+		insert(slot, inValue, hash, inIndex);
+	}
+}
+
+void Set::putz(Z inValue, int inIndex)
+{
+	if (mSize == mCap) {
+		grow();
+	}
+    
+	int hash = hashz(inValue);
+	int slot;
+	if (lookup(hash, [inValue](Arg testVal) { return testVal.isReal() && testVal.f == inValue; }, slot) < 0) {
+		insert(slot, V(inValue), hash, inIndex);
 	}
 }
 
 void Set::putAll(Thread& th, P<List>& in)
 {
     // caller must ensure that in is finite.
-    int64_t insize = in->length(th);
     in = in->pack(th);
-    for (int i = 0; i < insize; ++i) {
-        V val = in->at(i);
-        put(th, val, i);
-    }
+	Array* a = in->mArray();
+    int insize = (int)a->size();
+	if (a->isZ()) {
+		Z* z = a->z();
+		for (int i = 0; i < insize; ++i) {
+			putz(z[i], i);
+		}
+	} else {
+		V* v = a->v();
+		for (int i = 0; i < insize; ++i) {
+			put(th, v[i], i);
+		}
+	}
 }
 
 
@@ -250,7 +352,7 @@ static P<List> set_and(Thread& th, P<List> a, P<List> b)
     
     for (int64_t i = 0; i < setA->size(); ++i) {
         V v = setA->at(i);
-        if (setB->has(th, v)) out->add(v);
+        if (setB->has(th, v, setA->hashAt(i))) out->add(v);
     }
     
     return out;
@@ -264,7 +366,7 @@ static P<List> set_minus(Thread& th, P<List> a, P<List> b)
     
     for (int64_t i = 0; i < setA->size(); ++i) {
         V v = setA->at(i);
-        if (!setB->has(th, v)) out->add(v);
+        if (!setB->has(th, v, setA->hashAt(i))) out->add(v);
     }
     
     return out;
@@ -278,11 +380,11 @@ static P<List> set_xor(Thread& th, P<List> a, P<List> b)
     
     for (int64_t i = 0; i < setA->size(); ++i) {
         V v = setA->at(i);
-        if (!setB->has(th, v)) out->add(v);
+        if (!setB->has(th, v, setA->hashAt(i))) out->add(v);
     }
     for (int64_t i = 0; i < setB->size(); ++i) {
         V v = setB->at(i);
-        if (!setA->has(th, v)) out->add(v);
+        if (!setA->has(th, v, setB->hashAt(i))) out->add(v);
     }
     
     return out;
@@ -295,7 +397,7 @@ static bool subset(Thread& th, P<List> a, P<List> b)
 
     for (int64_t i = 0; i < setA->size(); ++i) {
         V v = setA->at(i);
-        if (!setB->has(th, v)) return false;
+        if (!setB->has(th, v, setA->hashAt(i))) return false;
     }
 	
 	return true;
@@ -418,6 +520,177 @@ static void set_equals_(Thread& th, Prim* prim)
     th.push(set_equals(th, a, b));
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+
+// ZIndex is a frozen index over the reals in a finite list, built once when a stream of reals is tested against it.
+// If the reals are all integers within a small span, as with scale degrees or pitch classes, lookup is a direct table.
+// Otherwise the unique reals are kept sorted and searched without branches, a batch of queries at a time,
+// so every query in the batch takes the same steps and the loads for them overlap.
+// NaN is never found and -0 finds 0, the same as in Set.
+
+const int kZIndexBatch = 8;
+const int64_t kZIndexMaxTableSpan = 4096;
+
+class ZIndex : public Object
+{
+	int mSize = 0;
+	Z* mKeys = nullptr;
+	int* mIndices = nullptr;
+	
+	int64_t mTableMin = 0;
+	int64_t mTableSpan = 0;
+	int* mTable = nullptr;
+	
+	ZIndex(const ZIndex& that) {}
+	
+	void build(std::vector<std::pair<Z,int>>& items);
+	void searchBatch(int n, const Z* in, int instride, int* found) const;
+	// n must be at most kZIndexBatch.
+	void lookup(int n, const Z* in, int instride, int* found) const;
+public:
+	ZIndex(Thread& th, P<List> list);
+	virtual ~ZIndex();
+	
+	virtual const char* TypeName() const override { return "ZIndex"; }
+	
+	// index in the source list of each real, or -1.
+	void indexOf(int n, const Z* in, int instride, Z* out) const;
+	// 1 if the source list contains each real, else 0.
+	void has(int n, const Z* in, int instride, Z* out) const;
+};
+
+ZIndex::ZIndex(Thread& th, P<List> list)
+{
+    // caller must ensure that list is finite.
+    list = list->pack(th);
+	Array* a = list->mArray();
+	int size = (int)a->size();
+	
+	std::vector<std::pair<Z,int>> items;
+	items.reserve(size);
+	if (a->isZ()) {
+		Z* z = a->z();
+		for (int i = 0; i < size; ++i) {
+			if (!std::isnan(z[i])) items.push_back({ z[i], i });
+		}
+	} else {
+		// only the reals in a mixed list can match.
+		V* v = a->v();
+		for (int i = 0; i < size; ++i) {
+			if (v[i].isReal() && !std::isnan(v[i].f)) items.push_back({ v[i].f, i });
+		}
+	}
+	build(items);
+}
+
+ZIndex::~ZIndex()
+{
+	free(mKeys);
+	free(mIndices);
+	free(mTable);
+}
+
+void ZIndex::build(std::vector<std::pair<Z,int>>& items)
+{
+	// sort by value, keeping the first occurrence of each value as find does.
+	std::stable_sort(items.begin(), items.end(), [](auto const& x, auto const& y) { return x.first < y.first; });
+	int size = 0;
+	for (size_t i = 0; i < items.size(); ++i) {
+		if (size && items[size-1].first == items[i].first) continue;
+		items[size++] = items[i];
+	}
+	items.resize(size);
+	mSize = size;
+	if (!size) return;
+	
+	Z lo = items.front().first;
+	Z hi = items.back().first;
+	bool integral = fabs(lo) < 1e15 && fabs(hi) < 1e15 && hi - lo < kZIndexMaxTableSpan;
+	for (int i = 0; integral && i < size; ++i) {
+		integral = floor(items[i].first) == items[i].first;
+	}
+	
+	if (integral) {
+		mTableMin = (int64_t)lo;
+		mTableSpan = (int64_t)hi - mTableMin + 1;
+		mTable = (int*)malloc(mTableSpan * sizeof(int));
+		for (int64_t i = 0; i < mTableSpan; ++i) mTable[i] = -1;
+		for (int i = 0; i < size; ++i) {
+			mTable[(int64_t)items[i].first - mTableMin] = items[i].second;
+		}
+	} else {
+		mKeys = (Z*)malloc(size * sizeof(Z));
+		mIndices = (int*)malloc(size * sizeof(int));
+		for (int i = 0; i < size; ++i) {
+			mKeys[i] = items[i].first;
+			mIndices[i] = items[i].second;
+		}
+	}
+}
+
+void ZIndex::searchBatch(int n, const Z* in, int instride, int* found) const
+{
+	const Z* keys = mKeys;
+	Z q[kZIndexBatch];
+	int base[kZIndexBatch];
+	for (int j = 0; j < n; ++j) {
+		q[j] = in[j * instride];
+		base[j] = 0;
+	}
+	// the answer lies in [base, base+len). the steps depend only on mSize, so all queries move together.
+	for (int len = mSize; len > 1; ) {
+		int half = len >> 1;
+		for (int j = 0; j < n; ++j) {
+			base[j] = keys[base[j] + half] <= q[j] ? base[j] + half : base[j];
+		}
+		len -= half;
+	}
+	for (int j = 0; j < n; ++j) {
+		found[j] = keys[base[j]] == q[j] ? mIndices[base[j]] : -1;
+	}
+}
+
+void ZIndex::lookup(int n, const Z* in, int instride, int* found) const
+{
+	if (mTable) {
+		Z lo = (Z)mTableMin;
+		Z hi = (Z)(mTableMin + mTableSpan - 1);
+		for (int i = 0; i < n; ++i) {
+			Z z = in[i * instride];
+			int k = -1;
+			if (z >= lo && z <= hi) {
+				int64_t iz = (int64_t)z;
+				if ((Z)iz == z) k = mTable[iz - mTableMin];
+			}
+			found[i] = k;
+		}
+	} else if (mSize) {
+		searchBatch(n, in, instride, found);
+	} else {
+		for (int i = 0; i < n; ++i) found[i] = -1;
+	}
+}
+
+void ZIndex::indexOf(int n, const Z* in, int instride, Z* out) const
+{
+	int found[kZIndexBatch];
+	for (int i = 0; i < n; i += kZIndexBatch) {
+		int m = std::min(kZIndexBatch, n - i);
+		lookup(m, in + i * instride, instride, found);
+		for (int j = 0; j < m; ++j) out[i+j] = found[j];
+	}
+}
+
+void ZIndex::has(int n, const Z* in, int instride, Z* out) const
+{
+	int found[kZIndexBatch];
+	for (int i = 0; i < n; i += kZIndexBatch) {
+		int m = std::min(kZIndexBatch, n - i);
+		lookup(m, in + i * instride, instride, found);
+		for (int j = 0; j < m; ++j) out[i+j] = found[j] >= 0;
+	}
+}
+
 struct FindV : Gen
 {
 	P<Set> mSet;
@@ -445,6 +718,7 @@ struct FindV : Gen
 				a += astride;
 			}
 			items.advance(n);
+			out += n;
 			framesToFill -= n;
 		}
 		produce(framesToFill);
@@ -453,11 +727,11 @@ struct FindV : Gen
 
 struct FindZ : Gen
 {
-	P<Set> mSet;
+	P<ZIndex> mIndex;
 	ZIn items;
 	
-	FindZ(Thread& th, Arg inItems, P<Set> const& inSet)
-		: Gen(th, itemTypeZ, inItems.isFinite()), mSet(inSet), items(inItems) {}
+	FindZ(Thread& th, Arg inItems, P<ZIndex> const& inIndex)
+		: Gen(th, itemTypeZ, inItems.isFinite()), mIndex(inIndex), items(inItems) {}
 		
 	const char* TypeName() const override { return "FindZ"; }
 	
@@ -473,12 +747,9 @@ struct FindZ : Gen
 				setDone();
 				break;
 			}
-			for (int i = 0; i < n; ++i) {
-				V va = *a;
-				out[i] = mSet->indexOf(th, va);
-				a += astride;
-			}
+			mIndex->indexOf(n, a, astride, out);
 			items.advance(n);
+			out += n;
 			framesToFill -= n;
 		}
 		produce(framesToFill);
@@ -513,6 +784,7 @@ struct SetHasV : Gen
 				a += astride;
 			}
 			items.advance(n);
+			out += n;
 			framesToFill -= n;
 		}
 		produce(framesToFill);
@@ -521,11 +793,11 @@ struct SetHasV : Gen
 
 struct SetHasZ : Gen
 {
-	P<Set> mSet;
+	P<ZIndex> mIndex;
 	ZIn items;
 	
-	SetHasZ(Thread& th, Arg inItems, P<Set> const& inSet)
-		: Gen(th, itemTypeV, inItems.isFinite()), mSet(inSet), items(inItems) {}
+	SetHasZ(Thread& th, Arg inItems, P<ZIndex> const& inIndex)
+		: Gen(th, itemTypeZ, inItems.isFinite()), mIndex(inIndex), items(inItems) {}
 		
 	const char* TypeName() const override { return "SetHasZ"; }
 	
@@ -541,29 +813,28 @@ struct SetHasZ : Gen
 				setDone();
 				break;
 			}
-			for (int i = 0; i < n; ++i) {
-				V va = *a;
-				out[i] = mSet->has(th, va);
-				a += astride;
-			}
+			mIndex->has(n, a, astride, out);
 			items.advance(n);
+			out += n;
 			framesToFill -= n;
 		}
 		produce(framesToFill);
 	}
 };
 
-static V findBase(Thread& th, V& a, P<Set> const& inSet)
+static V findBase(Thread& th, V& a, P<List> const& b)
 {
 	V result;
-	if (a.isList()) {
-		if (a.isZList()) {
-			result = new List(new FindZ(th, a, inSet));
+	if (a.isZList()) {
+		P<ZIndex> index = new ZIndex(th, b);
+		result = new List(new FindZ(th, a, index));
+	} else {
+		P<Set> setB = new Set(th, b);
+		if (a.isList()) {
+			result = new List(new FindV(th, a, setB));
 		} else {
-			result = new List(new FindV(th, a, inSet));
+			result = setB->indexOf(th, a);
 		}
-	} else {
-		result = inSet->indexOf(th, a);
 	}
 	return result;
 }
@@ -575,23 +846,23 @@ static void find_(Thread& th, Prim* prim)
         indefiniteOp("find : list", "");
 
 	V a = th.pop();
-
-    P<Set> setB = new Set(th, b);
 	
-	th.push(findBase(th, a, setB));
+	th.push(findBase(th, a, b));
 }
 
-static V hasBase(Thread& th, V& a, P<Set> const& inSet)
+static V hasBase(Thread& th, V& a, P<List> const& b)
 {
 	V result;
-	if (a.isList()) {
-		if (a.isZList()) {
-			result = new List(new SetHasZ(th, a, inSet));
+	if (a.isZList()) {
+		P<ZIndex> index = new ZIndex(th, b);
+		result = new List(new SetHasZ(th, a, index));
+	} else {
+		P<Set> setB = new Set(th, b);
+		if (a.isList()) {
+			result = new List(new SetHasV(th, a, setB));
 		} else {
-			result = new List(new SetHasV(th, a, inSet));
+			result = setB->has(th, a);
 		}
-	} else {
-		result = inSet->has(th, a);
 	}
 	return result;
 }
@@ -603,10 +874,8 @@ static void sethas_(Thread& th, Prim* prim)
         indefiniteOp("Shas : list", "");
 
 	V a = th.pop();
-
-    P<Set> setB = new Set(th, b);
 	
-	th.push(hasBase(th, a, setB));
+	th.push(hasBase(th, a, b));
 }
 
 #pragma mark ADD STREAM OPS
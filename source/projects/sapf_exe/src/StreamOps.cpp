@@ -444,6 +444,54 @@ V do_clipAt(Thread& th, P<Array> const& a, Arg i);
 V do_degkey(Thread& th, P<Array> const& a, Arg b, Z cycleWidth, int degreesPerCycle);
 V do_keydeg(Thread& th, P<Array> const& a, Arg b, Z cycleWidth, int degreesPerCycle);
 
+// gather kernels for reading a packed array at a run of real indexes.
+// indexes are truncated toward zero, then wrapped, folded or clipped as in Array.
+// gatherIndex returns -1 for an index out of range of at, and the kernels output 0 for it.
+
+enum { kGatherAt, kGatherWrap, kGatherFold, kGatherClip };
+
+template <int Mode>
+static inline int64_t gatherIndex(int64_t i, int64_t size)
+{
+	switch (Mode) {
+		case kGatherWrap : return sc_imod(i, size);
+		case kGatherFold : return (int64_t)sc_fold(i, 0, size-1);
+		case kGatherClip : return std::clamp<int64_t>(i, 0, size-1);
+		default : return i < 0 || i >= size ? -1 : i;
+	}
+}
+
+template <int Mode>
+static void gatherz(Array* a, int n, Z const* in, int instride, Z* out)
+{
+	int64_t size = a->size();
+	if (size == 0) {
+		for (int i = 0; i < n; ++i) out[i] = 0.;
+		return;
+	}
+	Z const* table = a->z();
+	for (int i = 0; i < n; ++i) {
+		int64_t k = gatherIndex<Mode>((int64_t)*in, size);
+		out[i] = Mode == kGatherAt && k < 0 ? 0. : table[k];
+		in += instride;
+	}
+}
+
+template <int Mode>
+static void gatherv(Array* a, int n, Z const* in, int instride, V* out)
+{
+	int64_t size = a->size();
+	if (size == 0) {
+		for (int i = 0; i < n; ++i) out[i] = 0.;
+		return;
+	}
+	for (int i = 0; i < n; ++i) {
+		int64_t k = gatherIndex<Mode>((int64_t)*in, size);
+		out[i] = Mode == kGatherAt && k < 0 ? V(0.) : a->_at(k);
+		in += instride;
+	}
+}
+
 class AtGenVV : public Gen
 {
 	P<Array> _a;
@@ -498,10 +546,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->at(*b);
-					b += bstride;
-				}
+				gatherv<kGatherAt>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -532,10 +577,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->atz(*b);
-					b += bstride;
-				}
+				gatherz<kGatherAt>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -600,10 +642,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->wrapAt(*b);
-					b += bstride;
-				}
+				gatherv<kGatherWrap>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -634,10 +673,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->wrapAtz(*b);
-					b += bstride;
-				}
+				gatherz<kGatherWrap>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -703,10 +739,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->foldAt(*b);
-					b += bstride;
-				}
+				gatherv<kGatherFold>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -737,10 +770,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->foldAtz(*b);
-					b += bstride;
-				}
+				gatherz<kGatherFold>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -806,10 +836,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->clipAt(*b);
-					b += bstride;
-				}
+				gatherv<kGatherClip>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -840,10 +867,7 @@ public:
 				setDone();
 				break;
 			} else {
-				for (int i = 0; i < n; ++i) {
-					out[i] = _a->clipAtz(*b);
-					b += bstride;
-				}
+				gatherz<kGatherClip>(_a(), n, b, bstride, out);
 				_b.advance(n);
 				framesToFill -= n;
 				out += n;
@@ -1392,6 +1416,125 @@ static void clipAt_(Thread& th, Prim* prim)
 	th.push(v);
 }
 
+// interpolated table reads. the index is split into floor and fraction, and the neighbouring points are read
+// with the same out of range rule as the plain version. cubic uses the same Lagrange interpolation as delayc.
+
+enum { kInterpLinear, kInterpCubic };
+
+template <int Mode>
+static inline Z gatherPoint(Z const* table, int64_t size, int64_t i)
+{
+	int64_t k = gatherIndex<Mode>(i, size);
+	return Mode == kGatherAt && k < 0 ? 0. : table[k];
+}
+
+template <int Mode, int Interp>
+static void gatherInterpz(Array* a, int n, Z const* in, int instride, Z* out)
+{
+	int64_t size = a->size();
+	if (size == 0) {
+		for (int i = 0; i < n; ++i) out[i] = 0.;
+		return;
+	}
+	Z const* table = a->z();
+	for (int i = 0; i < n; ++i) {
+		Z x = *in;
+		Z fl = floor(x);
+		Z frac = x - fl;
+		int64_t j = (int64_t)fl;
+		if (Interp == kInterpLinear) {
+			Z y1, y2;
+			if (j >= 0 && j + 1 < size) {
+				y1 = table[j];
+				y2 = table[j+1];
+			} else {
+				y1 = gatherPoint<Mode>(table, size, j);
+				y2 = gatherPoint<Mode>(table, size, j+1);
+			}
+			out[i] = y1 + frac * (y2 - y1);
+		} else {
+			Z y0, y1, y2, y3;
+			if (j >= 1 && j + 2 < size) {
+				y0 = table[j-1];
+				y1 = table[j];
+				y2 = table[j+1];
+				y3 = table[j+2];
+			} else {
+				y0 = gatherPoint<Mode>(table, size, j-1);
+				y1 = gatherPoint<Mode>(table, size, j);
+				y2 = gatherPoint<Mode>(table, size, j+1);
+				y3 = gatherPoint<Mode>(table, size, j+2);
+			}
+			out[i] = lagrangeInterpolate(frac, y0, y1, y2, y3);
+		}
+		in += instride;
+	}
+}
+
+template <int Mode, int Interp>
+class InterpAtGen : public Gen
+{
+	P<Array> _a;
+	ZIn _b;
+	const char* _name;
+public:
+	InterpAtGen(Thread& th, P<Array> const& a, Arg b, const char* name)
+		: Gen(th, itemTypeZ, b.isFinite()), _a(a), _b(b), _name(name) {}
+	
+	virtual const char* TypeName() const override { return _name; }
+	
+	virtual void pull(Thread& th) override {
+		int framesToFill = mBlockSize;
+		Z* out = mOut->fulfillz(framesToFill);
+		while (framesToFill) {
+			int n = framesToFill;
+			int bstride;
+			Z *b;
+			if (_b(th, n,bstride, b)) {
+				setDone();
+				break;
+			} else {
+				gatherInterpz<Mode, Interp>(_a(), n, b, bstride, out);
+				_b.advance(n);
+				framesToFill -= n;
+				out += n;
+			}
+		}
+		produce(framesToFill);
+	}
+	
+};
+
+template <int Mode, int Interp>
+static void interpAt(Thread& th, const char* name, const char* genName)
+{
+	V i = th.pop();
+	P<List> s = th.popList(name);
+
+	if (!s->isFinite())
+		indefiniteOp(name, "");
+
+	s = s->packz(th);
+	
+	if (i.isReal()) {
+		Z z = i.f;
+		Z v;
+		gatherInterpz<Mode, Interp>(s->mArray(), 1, &z, 1, &v);
+		th.push(v);
+	} else if (i.isZList()) {
+		th.push(new List(new InterpAtGen<Mode, Interp>(th, s->mArray, i, genName)));
+	} else wrongType(name, "Real or Signal", i);
+}
+
+static void atl_(Thread& th, Prim* prim) { interpAt<kGatherAt, kInterpLinear>(th, "atl", "AtLGen"); }
+static void atc_(Thread& th, Prim* prim) { interpAt<kGatherAt, kInterpCubic>(th, "atc", "AtCGen"); }
+static void wrapAtl_(Thread& th, Prim* prim) { interpAt<kGatherWrap, kInterpLinear>(th, "wrapAtl", "WrapAtLGen"); }
+static void wrapAtc_(Thread& th, Prim* prim) { interpAt<kGatherWrap, kInterpCubic>(th, "wrapAtc", "WrapAtCGen"); }
+static void foldAtl_(Thread& th, Prim* prim) { interpAt<kGatherFold, kInterpLinear>(th, "foldAtl", "FoldAtLGen"); }
+static void foldAtc_(Thread& th, Prim* prim) { interpAt<kGatherFold, kInterpCubic>(th, "foldAtc", "FoldAtCGen"); }
+static void clipAtl_(Thread& th, Prim* prim) { interpAt<kGatherClip, kInterpLinear>(th, "clipAtl", "ClipAtLGen"); }
+static void clipAtc_(Thread& th, Prim* prim) { interpAt<kGatherClip, kInterpCubic>(th, "clipAtc", "ClipAtCGen"); }
+
 
 #pragma mark CONVERSION
 
@@ -2486,93 +2629,57 @@ static void intz_(Thread& th, Prim* prim)
 
 struct Primes : Gen
 {
-	int byte;
-	int bit;
+	PrimeSieve sieve;
 	
-	Primes(Thread& th) : Gen(th, itemTypeV, false), byte(-1), bit(0) {}
+	Primes(Thread& th) : Gen(th, itemTypeV, false) {}
     
 	virtual const char* TypeName() const override { return "Primes"; }
         
 	virtual void pull(Thread& th) override
 	{
-		int n = mBlockSize;
-		V* out = mOut->fulfill(n);
-		for (int i = 0; i < n; ++i) {
-            if (byte < 0) {
-                out[i] = gLowPrimes[bit];
-                if (++bit >= 10) {
-                    byte = 0;
-                    bit = 0;
-                }
-            } else {
-                while (1) {
-					if (byte >= kPrimesMaskSize) {
-						setDone();
-						produce(n - i);
-						return;
-					} else if (gPrimesMask[byte] & (1 << bit)) {
-                        out[i] = 30 * (1 + byte) + gPrimeOffsets[bit];
-						if (++bit >= 8) {
-                            ++byte;
-                            bit = 0;
-                        }
-                        break;
-                    } else {
-						if (++bit >= 8) {
-                            ++byte;
-                            bit = 0;
-                        }
-                    }
-                }
-            }
-        }
-		mOut = mOut->nextp();
+		int framesToFill = mBlockSize;
+		V* out = mOut->fulfill(framesToFill);
+		while (framesToFill) {
+			int64_t primes[256];
+			int n = std::min(framesToFill, 256);
+			int m = sieve.next(n, primes);
+			for (int i = 0; i < m; ++i) out[i] = primes[i];
+			out += m;
+			framesToFill -= m;
+			if (m < n) {
+				setDone();
+				break;
+			}
+		}
+		produce(framesToFill);
     }
 };
 
 struct Primez : Gen
 {
-	int byte;
-	int bit;
+	PrimeSieve sieve;
 	
-	Primez(Thread& th) : Gen(th, itemTypeZ, false), byte(-1), bit(0) {}
+	Primez(Thread& th) : Gen(th, itemTypeZ, false) {}
     
 	virtual const char* TypeName() const override { return "Primez"; }
         
 	virtual void pull(Thread& th) override
 	{
-		int n = mBlockSize;
-		Z* out = mOut->fulfillz(n);
-		for (int i = 0; i < n; ++i) {
-            if (byte < 0) {
-                out[i] = gLowPrimes[bit];
-                if (++bit >= 10) {
-                    byte = 0;
-                    bit = 0;
-                }
-            } else {
-                while (1) {
-					if (byte >= kPrimesMaskSize) {
-						setDone();
-						produce(n - i);
-						return;
-                    } else if (gPrimesMask[byte] & (1 << bit)) {
-                        out[i] = 30 * (1 + byte) + gPrimeOffsets[bit];
-						if (++bit >= 8) {
-                            ++byte;
-                            bit = 0;
-                        }
-                        break;
-                    } else {
-                        if (++bit >= 8) {
-                            ++byte;
-                            bit = 0;
-                        }
-                    }
-                }
-            }
-        }
-		mOut = mOut->nextp();
+		int framesToFill = mBlockSize;
+		Z* out = mOut->fulfillz(framesToFill);
+		while (framesToFill) {
+			int64_t primes[256];
+			int n = std::min(framesToFill, 256);
+			int m = sieve.next(n, primes);
+			for (int i = 0; i < m; ++i) out[i] = primes[i];
+			out += m;
+			framesToFill -= m;
+			if (m < n) {
+				setDone();
+				break;
+			}
+		}
+		produce(framesToFill);
     }
 };
 
@@ -3300,6 +3407,36 @@ static void ncyc_(Thread& th, Prim* prim)
 }
 
 
+// If in is at the start of a segment, return that segment's array and step past it, so a
+// generator can pass it on whole instead of copying it. Empty segments are skipped.
+// Returns nullptr if in is part way through a segment, or at the end of its list, in
+// which case outEnded is set. Segments longer than maxSize are not taken.
+static P<Array> takeSegment(Thread& th, In& in, bool& outEnded, int64_t maxSize = INT64_MAX)
+{
+	outEnded = false;
+	if (in.isConstant()) return nullptr;
+	while (in.mList) {
+		in.mList->force(th);
+		P<Array> a = in.mList->mArray;
+		if (in.mOffset < a->size()) {
+			if (in.mOffset || a->size() > maxSize) return nullptr;
+			in.mList = in.mList->next();
+			return a;
+		}
+		in.mList = in.mList->next();
+		in.mOffset = 0;
+	}
+	outEnded = true;
+	return nullptr;
+}
+
+// hand a segment taken with takeSegment on to the output of g.
+static void spliceSegment(Gen* g, P<Array> const& a)
+{
+	g->mOut->fulfill(a);
+	g->mOut = g->mOut->nextp();
+}
+
 struct Append : Gen
 {
 	P<List> _a;
@@ -3352,8 +3489,46 @@ struct Cat : Gen
 	}
 	virtual const char* TypeName() const override { return "Cat"; }
 
+	// move on to the next list in b. returns true, having ended the output, if there is none.
+	bool nextList(Thread& th)
+	{
+		V b;
+		if (_b.one(th, b)) {
+			end();
+			return true;
+		}
+		if (b.isFunOrPrim()) {
+			SaveStack ss(th);
+			try {
+				b.apply(th);
+			} catch (...) {
+				end();
+				throw;
+			}
+			b = th.pop();
+		}
+		if (!b.isVList()) {
+			end();
+			return true;
+		}
+		_a.set(b);
+		return false;
+	}
+
 	virtual void pull(Thread& th) override
 	{
+		// whole segments are passed through. only a partly consumed one is copied.
+		while (1) {
+			bool ended;
+			P<Array> segment = takeSegment(th, _a, ended);
+			if (segment) {
+				spliceSegment(this, segment);
+				return;
+			}
+			if (!ended || nextList(th)) break;
+		}
+		if (mDone) return;
+
 		int framesToFill = mBlockSize;
 		V* out = mOut->fulfill(framesToFill);
 		while (framesToFill) {
@@ -3410,8 +3585,46 @@ struct CatZ : Gen
 	}
 	virtual const char* TypeName() const override { return "CatZ"; }
 
+	// move on to the next list in b. returns true, having ended the output, if there is none.
+	bool nextList(Thread& th)
+	{
+		V b;
+		if (_b.one(th, b)) {
+			end();
+			return true;
+		}
+		if (b.isFunOrPrim()) {
+			SaveStack ss(th);
+			try {
+				b.apply(th);
+			} catch (...) {
+				end();
+				throw;
+			}
+			b = th.pop();
+		}
+		if (!b.isZList()) {
+			end();
+			return true;
+		}
+		_a.set(b);
+		return false;
+	}
+
 	virtual void pull(Thread& th) override
 	{
+		// whole segments are passed through. only a partly consumed one is copied.
+		while (1) {
+			bool ended;
+			P<Array> segment = takeSegment(th, _a, ended);
+			if (segment) {
+				spliceSegment(this, segment);
+				return;
+			}
+			if (!ended || nextList(th)) break;
+		}
+		if (mDone) return;
+
 		int framesToFill = mBlockSize;
 		Z* out = mOut->fulfillz(framesToFill);
 		while (framesToFill) {
@@ -3456,6 +3669,42 @@ struct CatZ : Gen
 
 #include <stack>
 
+// pass a whole segment of the innermost list being flattened through, if it has no lists
+// in it that would be flattened in turn. levels are popped as they run out.
+static bool spliceFlatSegment(Thread& th, Gen* g, std::stack<VIn>& in, size_t depth)
+{
+	while (1) {
+		VIn& vin = in.top();
+		if (vin.isConstant())
+			return false;
+		if (vin.mList) {
+			vin.mList->force(th);
+			if (vin.mOffset == vin.mList->mArray->size()) {
+				vin.mList = vin.mList->next();
+				vin.mOffset = 0;
+				continue;
+			}
+		}
+		if (!vin.mList) {
+			if (in.size() == 1) return false;
+			in.pop();
+			continue;
+		}
+		Array* a = vin.mList->mArray();
+		if (vin.mOffset)
+			return false;
+		if (in.size() <= depth) {
+			for (int64_t i = 0; i < a->size(); ++i) {
+				if (a->v()[i].isVList()) return false;
+			}
+		}
+		bool ended;
+		P<Array> segment = takeSegment(th, vin, ended);
+		spliceSegment(g, segment);
+		return true;
+	}
+}
+
 struct Flat : Gen
 {
 	std::stack<VIn> in; // stack of list continuations
@@ -3469,6 +3718,9 @@ struct Flat : Gen
 
 	virtual void pull(Thread& th) override
 	{
+		if (spliceFlatSegment(th, this, in, SIZE_MAX))
+			return;
+
 		int framesToFill = mBlockSize;
 		V* out = mOut->fulfill(framesToFill);
 		VIn* vin = &in.top();
@@ -3509,6 +3761,9 @@ struct Flatten : Gen
 
 	virtual void pull(Thread& th) override
 	{
+		if (spliceFlatSegment(th, this, in, depth))
+			return;
+
 		int framesToFill = mBlockSize;
 		V* out = mOut->fulfill(framesToFill);
 		VIn* vin = &in.top();
@@ -3546,6 +3801,14 @@ struct Keep : Gen
 	virtual void pull(Thread& th) override {
 		if (_n <= 0) {
 			end();
+			return;
+		}
+		bool ended;
+		if (P<Array> segment = takeSegment(th, _a, ended, _n)) {
+			_n -= segment->size();
+			spliceSegment(this, segment);
+		} else if (ended) {
+			end();
 		} else {
             int framesToFill = (int)std::min(_n, (int64_t)mBlockSize);
             V* out = mOut->fulfill(framesToFill);
@@ -3623,6 +3886,14 @@ struct Keepz : Gen
 	virtual void pull(Thread& th) override {
 		if (_n <= 0) {
 			end();
+			return;
+		}
+		bool ended;
+		if (P<Array> segment = takeSegment(th, _a, ended, _n)) {
+			_n -= segment->size();
+			spliceSegment(this, segment);
+		} else if (ended) {
+			end();
 		} else {
             int framesToFill = (int)std::min(_n, (int64_t)mBlockSize);
             Z* out = mOut->fulfillz(framesToFill);
@@ -3947,14 +4218,15 @@ static void skip_positive_(Thread& th, P<List>& list, int64_t n)
 		int64_t asize = a->size();
 		if (asize > n) {
 			int64_t remain = asize - n;
-			Array* a2 = new Array(list->elemType, remain);
-			a2->setSize(remain);
+			Array* a2;
 			if (list->isVList()) {
+				a2 = new Array(list->elemType, remain);
+				a2->setSize(remain);
 				for (int64_t i = 0, j = n; i < remain; ++i, ++j) {
 					a2->v()[i] = a->v()[j];
 				}
 			} else {
-				memcpy(a2->z(), a->z() + n, remain * a->elemSize());
+				a2 = new Array(list->mArray, n, remain); // the rest of a signal segment is a view of it.
 			}
 			list = new List(a2, list->next());
 			return;
@@ -4589,9 +4861,7 @@ struct Hangz : Gen
 ended:
 			_a = nullptr;
 			Z* out = mOut->fulfillz(mBlockSize);
-			for (int i = 0; i < mBlockSize; ++i) {
-				out[i] = _b;
-			}
+			vDSP_vfillD(&_b, out, 1, mBlockSize);
 		}
 		mOut = mOut->nextp();
 	}
@@ -4920,9 +5190,7 @@ struct Spreadz : Gen
 		while (framesToFill) {			
 			if (n_) {
 				int n = std::min(n_, framesToFill);
-				for (int i = 0; i < n; ++i) {
-					out[i] = 0.;
-				}
+				memset(out, 0, n * sizeof(Z));
 				framesToFill -= n;
 				n_ -= n;
 				out += n;
@@ -5717,118 +5985,140 @@ static void sgram_(Thread& th, Prim* prim)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-static double bessi0(double x)
+static int64_t popWindowSize(Thread& th, const char* msg)
 {
-	//returns the modified Bessel function I_0(x) for any real x
-	//from numerical recipes
-	
-	double ax, ans;
-	double y;
-	
-	if((ax=fabs(x))<3.75){
-		y=x/3.75;
-		y *= y;
-		ans =1.0+y*(3.5156229+y*(3.0899424+y*(1.2067492
-			+y*(0.2659732+y*(0.360768e-1+y*0.45813e-2)))));
-	}
-	else{
-		y=3.75/ax;
-		ans = (exp(ax)/sqrt(ax))*(0.39894228+y*(0.1328592e-1
-			+y*(0.225319e-2+y*(-0.157565e-2+y*(0.916281e-2
-			+y*(-0.2057706e-1+y*(0.2635537e-1+y*(-0.1647633e-1
-			+y*0.392377e-2))))))));
+	int64_t n = th.popInt(msg);
+	if (n < 0) {
+		post("%s must not be negative\n", msg);
+		throw errOutOfRange;
 	}
-
-	return ans;
+	return n;
 }
 
-static double kaiser_alpha(double atten)
+static void kaiser_(Thread& th, Prim* prim)
 {
-	double alpha = 0.;
-	if (atten > 50.) 
-		alpha = .1102 * (atten - 8.7);
-	else if (atten >= 21.)
-		alpha = .5842 * pow(atten - 21., .4) + .07886 * (atten - 21.);
-	return alpha;
+	Z atten = fabs(th.popFloat("kaiser : stopband attenuation"));
+	int64_t n = popWindowSize(th, "kaiser : n");
+	
+	th.push(new List(getWindow(kWindowKaiser, n, atten)));
 }
 
-static void kaiser(size_t m, double *s, double alpha)
+static void hanning_(Thread& th, Prim* prim)
 {
-	if (m == 0) return;
-	if (m == 1) {
-		s[0] = 1.;
-		return;
-	}
-	size_t n = m-1;
-	double p = n / 2.;
-	double rp = 1. / p;
-	double rb = 1. / bessi0(alpha);
+	int64_t n = popWindowSize(th, "hanning : n");
 	
-	for (size_t i = 0; i < m; ++i) {
-		double x = (i-p) * rp;
-		s[i] = rb * bessi0(alpha * sqrt(1. - x*x));
-	}
+	th.push(new List(getWindow(kWindowHann, n)));
 }
 
-static void kaiser_(Thread& th, Prim* prim)
+static void hamming_(Thread& th, Prim* prim)
 {
-	Z atten = fabs(th.popFloat("kaiser : stopband attenuation"));
-	int64_t n = th.popInt("kaiser : n");
+	int64_t n = popWindowSize(th, "hamming : n");
 	
-	P<List> out = new List(itemTypeZ, n);
-	out->mArray->setSize(n);
-	
-	Z alpha = kaiser_alpha(atten);
-	kaiser(n, out->mArray->z(), alpha);
-	
-	th.push(out);
+	th.push(new List(getWindow(kWindowHamming, n)));
 }
 
-
-static void hanning_(Thread& th, Prim* prim)
+static void blackman_(Thread& th, Prim* prim)
 {
-	int64_t n = th.popInt("hanning : n");
-	
-	P<List> out = new List(itemTypeZ, n);
-	out->mArray->setSize(n);
+	int64_t n = popWindowSize(th, "blackman : n");
 	
-	vDSP_hann_windowD(out->mArray->z(), n, 0);
-	
-	th.push(out);
+	th.push(new List(getWindow(kWindowBlackman, n)));
 }
 
-static void hamming_(Thread& th, Prim* prim)
+static void blackmanharris_(Thread& th, Prim* prim)
 {
-	int64_t n = th.popInt("hanning : n");
-	
-	P<List> out = new List(itemTypeZ, n);
-	out->mArray->setSize(n);
+	int64_t n = popWindowSize(th, "blackmanharris : n");
 	
-	vDSP_hamm_windowD(out->mArray->z(), n, 0);
-	
-	th.push(out);
+	th.push(new List(getWindow(kWindowBlackmanHarris, n)));
 }
 
-static void blackman_(Thread& th, Prim* prim)
+static void gausswin_(Thread& th, Prim* prim)
 {
-	int64_t n = th.popInt("hanning : n");
-	
-	P<List> out = new List(itemTypeZ, n);
-	out->mArray->setSize(n);
+	Z sigma = th.popFloat("gausswin : sigma");
+	int64_t n = popWindowSize(th, "gausswin : n");
+	if (sigma <= 0.) {
+		post("gausswin : sigma must be positive\n");
+		throw errOutOfRange;
+	}
 	
-	vDSP_blkman_windowD(out->mArray->z(), n, 0);
+	th.push(new List(getWindow(kWindowGaussian, n, sigma)));
+}
+
+static void tukey_(Thread& th, Prim* prim)
+{
+	Z taper = std::clamp(th.popFloat("tukey : taper"), 0., 1.);
+	int64_t n = popWindowSize(th, "tukey : n");
 	
-	th.push(out);
+	th.push(new List(getWindow(kWindowTukey, n, taper)));
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Input history for overlapping segments. Each input sample is read once into a
+// contiguous buffer and segments are views of it, so overlap costs no copying. When the
+// buffer is full, the samples still needed move to a new one; segments already handed out
+// keep the old one alive.
+const int64_t kSegmentHistorySize = 16384;
+
+struct SegmentHistory
+{
+	P<Array> buf;
+	int64_t bufPos = 0;  // input index of buf's first sample
+	int64_t bufCap = 0;
+	int64_t pos = 0;     // input index of the next segment's first sample
+	
+	// make the length samples from pos available. returns true if the input ran out in
+	// them, in which case the rest are zero.
+	bool fill(Thread& th, ZIn& in, int length)
+	{
+		int64_t end = pos + length;
+		int64_t bufEnd = bufPos + (buf() ? buf->size() : 0);
+		if (!buf() || end > bufPos + bufCap) {
+			int64_t cap = std::max(kSegmentHistorySize, 4 * (int64_t)length);
+			P<Array> newBuf = new Array(itemTypeZ, cap);
+			int64_t keep = std::max(int64_t(0), bufEnd - pos);
+			if (keep)
+				memcpy(newBuf->z(), buf->z() + (pos - bufPos), keep * sizeof(Z));
+			newBuf->setSize(keep);
+			if (pos > bufEnd)
+				in.hop(th, (int)(pos - bufEnd));
+			buf = newBuf;
+			bufPos = pos;
+			bufCap = cap;
+			bufEnd = pos + keep;
+		}
+		
+		bool ended = false;
+		Z* out = buf->z() + (bufEnd - bufPos);
+		while (bufEnd < end) {
+			int n = (int)(end - bufEnd);
+			int stride;
+			Z* a;
+			if (in(th, n, stride, a)) {
+				ended = true;
+				memset(out, 0, (end - bufEnd) * sizeof(Z));
+				bufEnd = end;
+				break;
+			}
+			memcpy(out, a, n * sizeof(Z));
+			in.advance(n);
+			out += n;
+			bufEnd += n;
+		}
+		buf->setSize(bufEnd - bufPos);
+		return ended;
+	}
+	
+	Z* samples() { return buf->z() + (pos - bufPos); }
+	P<Array> view(int length) { return new Array(buf, pos - bufPos, length); }
+};
+
 struct Segment : public Gen
 {
 	ZIn in_;
 	BothIn hop_;
 	BothIn length_;
+	SegmentHistory history_;
 	int offset;
     Z fracsamp_;
     Z sr_;
@@ -5854,10 +6144,16 @@ struct Segment : public Gen
 			}
 			
 			int length = (int)floor(sr_ * zlength + .5);
-			P<List> segment = new List(itemTypeZ, length);
-			segment->mArray->setSize(length);
-			bool nomore = in_.fillSegment(th, length, segment->mArray->z());
-			out[i] = segment;
+			bool nomore;
+			if (in_.isConstant()) {
+				P<List> segment = new List(itemTypeZ, length);
+				segment->mArray->setSize(length);
+				nomore = in_.fillSegment(th, length, segment->mArray->z());
+				out[i] = segment;
+			} else {
+				nomore = history_.fill(th, in_, length);
+				out[i] = new List(history_.view(length));
+			}
 			++framesFilled;
 			if (nomore) {
 				setDone();
@@ -5873,7 +6169,8 @@ struct Segment : public Gen
             Z ihop = floor(fhop);
             fracsamp_ = fhop - ihop;
             
-			in_.hop(th, (int)ihop);
+			if (in_.isConstant()) in_.hop(th, (int)ihop);
+			else history_.pos += (int64_t)ihop;
 		}
 	leave:
 		produce(framesToFill - framesFilled);
@@ -5898,6 +6195,7 @@ struct WinSegment : public Gen
 	ZIn in_;
 	BothIn hop_;
 	P<Array> window_;
+	SegmentHistory history_;
     int length_;
 	int offset;
     Z fracsamp_;
@@ -5923,8 +6221,15 @@ struct WinSegment : public Gen
 			P<List> segment = new List(itemTypeZ, length_);
 			segment->mArray->setSize(length_);
             Z* segbuf = segment->mArray->z();
-			bool nomore = in_.fillSegment(th, (int)length_, segbuf);
-            vDSP_vmulD(segbuf, 1, window_->z(), 1, segbuf, 1, length_);
+			bool nomore;
+			if (in_.isConstant()) {
+				nomore = in_.fillSegment(th, (int)length_, segbuf);
+				vDSP_vmulD(segbuf, 1, window_->z(), 1, segbuf, 1, length_);
+			} else {
+				// windowed straight from the history, so overlapping input isn't copied again.
+				nomore = history_.fill(th, in_, length_);
+				vDSP_vmulD(history_.samples(), 1, window_->z(), 1, segbuf, 1, length_);
+			}
 			out[i] = segment;
 			++framesFilled;
 			if (nomore) {
@@ -5941,7 +6246,8 @@ struct WinSegment : public Gen
             Z ihop = floor(fhop);
             fracsamp_ = fhop - ihop;
             
-			in_.hop(th, (int)ihop);
+			if (in_.isConstant()) in_.hop(th, (int)ihop);
+			else history_.pos += (int64_t)ihop;
 		}
 	leave:
 		produce(framesToFill - framesFilled);
@@ -6902,6 +7208,248 @@ static void mergec_(Thread& th, Prim* prim)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// k-way merge. instead of a tree of two-way merges, the heads of all the sorted inputs are kept in a binary heap
+// of input indices. the winning input is drained while it stays ahead of the runner up, so sorted runs
+// are copied without touching the heap. with no function, values compare natively and ties go to the lower input index.
+
+struct KMerge : Gen
+{
+	std::vector<VIn> ins_;
+	std::vector<V> heads_;
+	std::vector<int> heap_;
+	V fun_;
+	bool hasFun_;
+	bool once = true;
+    
+	KMerge(Thread& th, bool inFinite, size_t n, V* inArgs, Arg fun, bool hasFun)
+		: Gen(th, itemTypeV, inFinite), heads_(n), fun_(fun), hasFun_(hasFun)
+	{
+		ins_.reserve(n);
+		heap_.reserve(n);
+		for (size_t i = 0; i < n; ++i) {
+			ins_.push_back(VIn(inArgs[i]));
+		}
+	}
+	    
+	virtual const char* TypeName() const override { return "KMerge"; }
+	
+	bool less(Thread& th, int a, int b)
+	{
+		if (hasFun_) {
+			SaveStack ss(th);
+			th.push(heads_[a]);
+			th.push(heads_[b]);
+			fun_.apply(th);
+			return th.pop().isTrue();
+		}
+		int result = ::Compare(th, heads_[a], heads_[b]);
+		return result < 0 || (result == 0 && a < b);
+	}
+	
+	void siftDown(Thread& th, size_t i)
+	{
+		size_t n = heap_.size();
+		while (1) {
+			size_t child = 2 * i + 1;
+			if (child >= n) break;
+			if (child + 1 < n && less(th, heap_[child+1], heap_[child])) ++child;
+			if (!less(th, heap_[child], heap_[i])) break;
+			std::swap(heap_[child], heap_[i]);
+			i = child;
+		}
+	}
+	
+	virtual void pull(Thread& th) override {
+		if (once) {
+			once = false;
+			for (size_t k = 0; k < ins_.size(); ++k) {
+				if (!ins_[k].one(th, heads_[k])) heap_.push_back((int)k);
+			}
+			for (size_t k = heap_.size() / 2; k-- > 0; ) siftDown(th, k);
+		}
+		
+		int framesToFill = mBlockSize;
+		V* out = mOut->fulfill(framesToFill);
+		int i = 0;
+		while (i < framesToFill) {
+			if (heap_.size() < 2) {
+				if (heap_.size()) {
+					// one input left. link the rest of it.
+					out[i++] = heads_[heap_[0]];
+					produce(framesToFill - i);
+					ins_[heap_[0]].link(th, mOut);
+				} else {
+					produce(framesToFill - i);
+				}
+				setDone();
+				return;
+			}
+			int top = heap_[0];
+			int runnerUp = (heap_.size() == 2 || less(th, heap_[1], heap_[2])) ? heap_[1] : heap_[2];
+			bool exhausted = false;
+			do {
+				out[i++] = heads_[top];
+				if (ins_[top].one(th, heads_[top])) {
+					exhausted = true;
+					break;
+				}
+			} while (i < framesToFill && less(th, top, runnerUp));
+			if (exhausted) {
+				heads_[top] = 0.;
+				heap_[0] = heap_.back();
+				heap_.pop_back();
+			}
+			siftDown(th, 0);
+		}
+		produce(0);
+	}
+};
+
+struct KMergeZ : Gen
+{
+	std::vector<ZIn> ins_;
+	std::vector<Z> heads_;
+	std::vector<int> heap_;
+	V fun_;
+	bool hasFun_;
+	bool once = true;
+    
+	KMergeZ(Thread& th, bool inFinite, size_t n, V* inArgs, Arg fun, bool hasFun)
+		: Gen(th, itemTypeZ, inFinite), heads_(n), fun_(fun), hasFun_(hasFun)
+	{
+		ins_.reserve(n);
+		heap_.reserve(n);
+		for (size_t i = 0; i < n; ++i) {
+			ins_.push_back(ZIn(inArgs[i]));
+		}
+	}
+	    
+	virtual const char* TypeName() const override { return "KMergeZ"; }
+	
+	bool less(Thread& th, int a, int b)
+	{
+		if (hasFun_) {
+			SaveStack ss(th);
+			th.push(heads_[a]);
+			th.push(heads_[b]);
+			fun_.apply(th);
+			return th.pop().isTrue();
+		}
+		Z za = heads_[a];
+		Z zb = heads_[b];
+		return za < zb || (za == zb && a < b);
+	}
+	
+	void siftDown(Thread& th, size_t i)
+	{
+		size_t n = heap_.size();
+		while (1) {
+			size_t child = 2 * i + 1;
+			if (child >= n) break;
+			if (child + 1 < n && less(th, heap_[child+1], heap_[child])) ++child;
+			if (!less(th, heap_[child], heap_[i])) break;
+			std::swap(heap_[child], heap_[i]);
+			i = child;
+		}
+	}
+	
+	virtual void pull(Thread& th) override {
+		if (once) {
+			once = false;
+			for (size_t k = 0; k < ins_.size(); ++k) {
+				if (!ins_[k].onez(th, heads_[k])) heap_.push_back((int)k);
+			}
+			for (size_t k = heap_.size() / 2; k-- > 0; ) siftDown(th, k);
+		}
+		
+		int framesToFill = mBlockSize;
+		Z* out = mOut->fulfillz(framesToFill);
+		int i = 0;
+		while (i < framesToFill) {
+			if (heap_.size() < 2) {
+				if (heap_.size()) {
+					// one input left. link the rest of it.
+					out[i++] = heads_[heap_[0]];
+					produce(framesToFill - i);
+					ins_[heap_[0]].link(th, mOut);
+				} else {
+					produce(framesToFill - i);
+				}
+				setDone();
+				return;
+			}
+			int top = heap_[0];
+			int runnerUp = (heap_.size() == 2 || less(th, heap_[1], heap_[2])) ? heap_[1] : heap_[2];
+			bool exhausted = false;
+			do {
+				out[i++] = heads_[top];
+				if (ins_[top].onez(th, heads_[top])) {
+					exhausted = true;
+					break;
+				}
+			} while (i < framesToFill && less(th, top, runnerUp));
+			if (exhausted) {
+				heap_[0] = heap_.back();
+				heap_.pop_back();
+			}
+			siftDown(th, 0);
+		}
+		produce(0);
+	}
+};
+
+static void kmerge(Thread& th, const char* name, P<List> const& s0, Arg fun, bool hasFun)
+{
+	if (!s0->isVList())
+		wrongType(name, "VList", s0);
+		
+	if (!s0->isFinite())
+		indefiniteOp(name, "");
+	
+	P<List> s = s0->pack(th);
+	
+	V* args = s->mArray->v();
+	size_t N = s->mArray->size();
+	
+	bool isFinite = true;
+	bool allZ = true;
+	bool allV = true;
+	for (size_t k = 0; k < N; ++k) {
+		if (!args[k].isList())
+			wrongType(name, "List", args[k]);
+		if (!args[k].isFinite()) 
+			isFinite = false;
+		if (args[k].isZList())
+			allV = false;
+		else
+			allZ = false;
+	}
+	
+	if (N && allZ) {
+		th.push(new List(new KMergeZ(th, isFinite, N, args, fun, hasFun)));
+	} else if (allV) {
+		th.push(new List(new KMerge(th, isFinite, N, args, fun, hasFun)));
+	} else {
+		post("%s lists not same type\n", name);
+		throw errFailed;
+	}
+}
+
+static void kmerge_(Thread& th, Prim* prim)
+{
+	P<List> s = th.popList("kmerge : lists");
+	kmerge(th, "kmerge : lists", s, V(0.), false);
+}
+
+static void kmergef_(Thread& th, Prim* prim)
+{
+	V fun = th.pop();
+	P<List> s = th.popList("kmergef : lists");
+	kmerge(th, "kmergef : lists", s, fun, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 //evmerge
 
 extern P<String> s_dt;
@@ -7571,7 +8119,7 @@ void AddStreamOps()
 	DEFnoeach(evens,  0, 1, "(--> series) return an infinite series of ascending non-negative even integers.")
 	DEFnoeach(odds,   0, 1, "(--> series) return an infinite series of ascending non-negative odd integers.")
 	DEFnoeach(ints,   0, 1, "(--> series) return the infinite series [0 1 -1 2 -2 3 -3...]")
-	DEFnoeach(primes, 0, 1, "(--> series) returns a finite series of prime numbers up to 1000039.")
+	DEFnoeach(primes, 0, 1, "(--> series) returns a series of the prime numbers below 10^12.")
 	DEFAM(fib, kk, "(a b --> series) returns a fibonacci series starting with the two numbers given.") 
 
 	DEFnoeach(ordz,   0, 1, "(--> signal) return an infinite signal of integers ascending from 1.")
@@ -7581,7 +8129,7 @@ void AddStreamOps()
 	DEFnoeach(evenz,  0, 1, "(--> signal) return an infinite signal of ascending non-negative even integers.")
 	DEFnoeach(oddz,   0, 1, "(--> signal) return an infinite signal of ascending non-negative odd integers.")
 	DEFnoeach(intz,   0, 1, "(--> signal) return the infinite signal [0 1 -1 2 -2 3 -3...]")
-	DEFnoeach(primez, 0, 1, "(--> signal) returns a finite signal of prime numbers up to 1000039.")	
+	DEFnoeach(primez, 0, 1, "(--> signal) returns a signal of the prime numbers below 10^12.")	
 	DEFMCX(fibz, 2, "(a b --> signal) returns a fibonacci signal starting with the two numbers given.")
 
 	DEFAM(ninvs, k, "(n --> stream) return a finite stream of n reciprocals. equivalent to n 1 1 nby 1/")
@@ -7687,6 +8235,8 @@ void AddStreamOps()
 	DEF(lace, 1, 1, "(a --> b) returns the concatenation of the transpose of the list of lists a.")	
 	DEFAM(merge, aak, "(a b fun --> c) merges two lists according to the function given. The function should work like <.")
 	DEFAM(mergec, aak, "(a b fun --> c) merges two lists without duplicates according to the function given. The function should work like cmp.")
+	DEF(kmerge, 1, 1, "(lists --> c) merges a finite list of sorted lists into one sorted list in ascending order.")
+	DEFAM(kmergef, ak, "(lists fun --> c) merges a finite list of sorted lists according to the function given. The function should work like <.")
 	
 	DEF(perms, 1, 1, "(a --> b) returns a list of all permutations of the input list.")
 	DEFMCX(permz, 1, "(a --> b) returns a list of all permutations of the input signal. automaps over streams.")
@@ -7740,9 +8290,17 @@ void AddStreamOps()
 	DEF(muss, 1, 1, "(a --> b) puts a finite sequence into a random order.")
 
 	DEF(at, 2, 1, "(seq index(es) --> value(s)) looks up item(s) in sequence at index(es). out of range indexes return zero.") 
-	DEF(wrapAt, 2, 1, "(seq index(es) --> value(s)) looks up item(s) in sequence at index(es). out of range indexes return the value at the end point.") 
-	DEF(foldAt, 2, 1, "(seq index(es) --> value(s)) looks up item(s) in sequence at index(es). out of range indexes return the items from the cyclic sequence.") 
-	DEF(clipAt, 2, 1, "(seq index(es) --> value(s)) looks up item(s) in sequence at index(es). out of range indexes return items from the cyclic mirrored sequence.") 
+	DEF(wrapAt, 2, 1, "(seq index(es) --> value(s)) looks up item(s) in sequence at index(es). out of range indexes return the items from the cyclic sequence.") 
+	DEF(foldAt, 2, 1, "(seq index(es) --> value(s)) looks up item(s) in sequence at index(es). out of range indexes return items from the cyclic mirrored sequence.") 
+	DEF(clipAt, 2, 1, "(seq index(es) --> value(s)) looks up item(s) in sequence at index(es). out of range indexes return the value at the end point.") 
+	DEFAM(atl, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with linear interpolation. out of range indexes return zero.") 
+	DEFAM(atc, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with cubic interpolation. out of range indexes return zero.") 
+	DEFAM(wrapAtl, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with linear interpolation. out of range indexes return the items from the cyclic sequence.") 
+	DEFAM(wrapAtc, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with cubic interpolation. out of range indexes return the items from the cyclic sequence.") 
+	DEFAM(foldAtl, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with linear interpolation. out of range indexes return items from the cyclic mirrored sequence.") 
+	DEFAM(foldAtc, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with cubic interpolation. out of range indexes return items from the cyclic mirrored sequence.") 
+	DEFAM(clipAtl, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with linear interpolation. out of range indexes return the value at the end point.") 
+	DEFAM(clipAtc, az, "(seq index(es) --> value(s)) reads a numeric sequence at fractional index(es) with cubic interpolation. out of range indexes return the value at the end point.") 
 	DEF(degkey, 2, 1, "(degree scale --> converts scale degree(s) to keys, given a scale");
 	DEF(keydeg, 2, 1, "(key scale --> converts key(s) to scale degree(s), given a scale");
 
@@ -7766,6 +8324,9 @@ void AddStreamOps()
 	DEFMCX(hanning, 1, "(n --> out) returns a signal filled with a Hanning window.")
 	DEFMCX(hamming, 1, "(n --> out) returns a signal filled with a Hamming window.")
 	DEFMCX(blackman, 1, "(n --> out) returns a signal filled with a Blackman window.")
+	DEFMCX(blackmanharris, 1, "(n --> out) returns a signal filled with a 4 term Blackman-Harris window.")
+	DEFMCX(gausswin, 2, "(n sigma --> out) returns a signal filled with a Gaussian window. sigma is the standard deviation as a fraction of half the window.")
+	DEFMCX(tukey, 2, "(n taper --> out) returns a signal filled with a Tukey window. taper is the fraction of the window taken up by the cosine tapers, from 0 (rectangular) to 1 (Hann).")
 	DEFMCX(fft, 2, "(re im --> out) returns the complex FFT of two vectors (one real and one imaginary) which are a power of two length.")		
 	DEFMCX(ifft, 2, "(re im --> out) returns the complex IFFT of two vectors (one real and one imaginary) which are a power of two length.")		
 
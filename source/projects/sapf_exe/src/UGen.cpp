@@ -19,11 +19,17 @@
 #include "VM.hpp"
 #include "MultichannelExpansion.hpp"
 #include "clz.hpp"
+#include "dsp.hpp"
 #include <cmath>
 #include <float.h>
 #include <vector>
 #include <algorithm>
 #include <Accelerate/Accelerate.h>
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 
 
@@ -342,18 +348,73 @@ static void endfade_(Thread& th, Prim* prim)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Event time kept as a whole number of samples at a fixed increment since the last rate change.
+// A steady rate accumulates no rounding error no matter how long it runs, and the number of samples
+// until the next event can be computed directly instead of testing every sample.
+struct SampleClock
+{
+	Z base_ = 0.;		// time at the last rate change
+	Z inc_ = 0.;		// time per sample
+	int64_t count_ = 0; // samples since the last rate change
+
+	Z at(int k) const { return base_ + (Z)(count_ + k) * inc_; }
+	Z now() const { return at(0); }
+
+	void setRate(Z inc)
+	{
+		if (inc != inc_) {
+			base_ = now();
+			count_ = 0;
+			inc_ = inc;
+		}
+	}
+	void advance(int n) { count_ += n; }
+	// rebases on the current time so that the clock stays bounded between events, as a plain phase would.
+	void subtract(Z t)
+	{
+		base_ = now() - t;
+		count_ = 0;
+	}
+	
+	// fills out with the time at each of the next n samples and advances.
+	void fill(Z* out, int n)
+	{
+		Z base = base_;
+		Z inc = inc_;
+		int64_t count = count_;
+		for (int i = 0; i < n; ++i) {
+			out[i] = base + (Z)(count + i) * inc;
+		}
+		count_ += n;
+	}
+
+	// number of samples before the time reaches t, at most n.
+	int framesUntil(Z t, int n) const
+	{
+		if (inc_ <= 0.) return now() >= t ? 0 : n;
+		Z est = ceil((t - base_) / inc_) - (Z)count_;
+		if (est > n + 1.) return n;
+		int k = est < 0. ? 0 : (int)est;
+		// the estimate can be off by one sample from rounding.
+		while (k > 0 && at(k - 1) >= t) --k;
+		while (k < n && at(k) < t) ++k;
+		return std::min(k, n);
+	}
+};
+
 struct Imps : public Gen
 {
 	BothIn durs_;
 	BothIn vals_;
 	ZIn rate_;
 	Z val_;
-	Z phase_, dur_, invdur_;
+	Z dur_;
 	Z freqmul_;
+	SampleClock phase_;
 	bool once;
 
 	Imps(Thread& th, Arg durs, Arg vals, Arg rate) : Gen(th, itemTypeZ, mostFinite(vals, durs, rate)), durs_(durs), vals_(vals), rate_(rate),
-		phase_(0.), dur_(0.), freqmul_(th.rate.invSampleRate), once(false)
+		dur_(0.), freqmul_(th.rate.invSampleRate), once(false)
 	{
 	}
 
@@ -372,12 +433,15 @@ struct Imps : public Gen
 				setDone();
 				break;
 			}
-			for (int i = 0; i < n; ++i) {
-				while (phase_ >= dur_) {
-					phase_ -= dur_;
+			if (rateStride == 0) phase_.setRate(*rate * freqmul_);
+			for (int i = 0; i < n;) {
+				if (rateStride) phase_.setRate(rate[i * rateStride] * freqmul_);
+				while (phase_.now() >= dur_) {
+					phase_.subtract(dur_);
 					do {
 						if (vals_.onez(th, val_) || durs_.onez(th, dur_)) {
 							setDone();
+							framesToFill -= i;
 							goto leave;
 						}
 					} while (dur_ <= 0.);
@@ -390,12 +454,20 @@ struct Imps : public Gen
 				} else {
 					out[i] = 0.;
 				}
-				phase_ += *rate * freqmul_;
-				rate += rateStride;
-				--framesToFill;
+				phase_.advance(1);
+				++i;
+				
+				if (rateStride == 0) {
+					// skip to the next impulse.
+					int k = phase_.framesUntil(dur_, n - i);
+					memset(out + i, 0, k * sizeof(Z));
+					phase_.advance(k);
+					i += k;
+				}
 			}
+			framesToFill -= n;
 			out += n;
-			
+			rate_.advance(n);
 		}
 leave:
 		produce(framesToFill);
@@ -511,6 +583,46 @@ leave:
 	}
 };
 
+// advances phase by inc once per frame until it reaches end, for at most n frames, and returns the number of frames.
+// the phase is summed a frame at a time so that a segment ends on the same frame as it would in a per sample loop.
+static int advancePhase(Z& phase, Z end, Z inc, int n)
+{
+	int k = 0;
+	do {
+		phase += inc;
+		++k;
+	} while (k < n && phase < end);
+	return k;
+}
+
+// out[i] = start * ratio^i. returns start * ratio^n.
+// four independent products per step so the loop vectorizes instead of waiting on one running product.
+static Z geomSeries(Z* out, int n, Z start, Z ratio)
+{
+	Z r2 = ratio * ratio;
+	Z r4 = r2 * r2;
+	Z a0 = start;
+	Z a1 = start * ratio;
+	Z a2 = a1 * ratio;
+	Z a3 = a2 * ratio;
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		out[i] = a0;
+		out[i+1] = a1;
+		out[i+2] = a2;
+		out[i+3] = a3;
+		a0 *= r4;
+		a1 *= r4;
+		a2 *= r4;
+		a3 *= r4;
+	}
+	for (; i < n; ++i) {
+		out[i] = a0;
+		a0 *= ratio;
+	}
+	return a0;
+}
+
 struct Lines : public Gen
 {
 	BothIn durs_;
@@ -545,24 +657,50 @@ struct Lines : public Gen
 				break;
 			}
 
-			for (int i = 0; i < n; ++i) {
-				while (phase_ >= dur_) {
-					phase_ -= dur_;
-					do {
-						oldval_ = newval_;
-						if (vals_.onez(th, newval_) || durs_.onez(th, dur_)) {
-							setDone();
-							goto leave;
-						}
-					} while (dur_ <= 0.);
-					slope_ = (newval_ - oldval_) / dur_;
+			if (rateStride == 0) {
+				// render a segment at a time.
+				Z freq = *rate * freqmul_;
+				for (int i = 0; i < n;) {
+					while (phase_ >= dur_) {
+						phase_ -= dur_;
+						do {
+							oldval_ = newval_;
+							if (vals_.onez(th, newval_) || durs_.onez(th, dur_)) {
+								setDone();
+								goto leave;
+							}
+						} while (dur_ <= 0.);
+						slope_ = (newval_ - oldval_) / dur_;
+					}
+
+					Z start = oldval_ + slope_ * phase_;
+					Z step = slope_ * freq;
+					int k = advancePhase(phase_, dur_, freq, n - i);
+					vDSP_vrampD(&start, &step, out + i, 1, k);
+
+					i += k;
+					framesToFill -= k;
 				}
+			} else {
+				for (int i = 0; i < n; ++i) {
+					while (phase_ >= dur_) {
+						phase_ -= dur_;
+						do {
+							oldval_ = newval_;
+							if (vals_.onez(th, newval_) || durs_.onez(th, dur_)) {
+								setDone();
+								goto leave;
+							}
+						} while (dur_ <= 0.);
+						slope_ = (newval_ - oldval_) / dur_;
+					}
 
-				out[i] = oldval_ + slope_ * phase_;
+					out[i] = oldval_ + slope_ * phase_;
 
-				phase_ += *rate * freqmul_;
-				rate += rateStride;
-				--framesToFill;
+					phase_ += *rate * freqmul_;
+					rate += rateStride;
+					--framesToFill;
+				}
 			}
 			out += n;
 			rate_.advance(n);
@@ -608,7 +746,7 @@ struct XLines : public Gen
 			}
 
 			if (rateStride == 0) {
-				for (int i = 0; i < n; ++i) {
+				for (int i = 0; i < n;) {
 					while (phase_ >= dur_) {
 						phase_ -= dur_;
 						do {
@@ -625,11 +763,12 @@ struct XLines : public Gen
 						step_ = pow(ratio_, freq_ * invdur_);
 					}
 
-					out[i] = oldval_;
-					oldval_ *= step_;
+					// render the rest of the segment as a geometric series.
+					int k = advancePhase(phase_, dur_, freq_, n - i);
+					oldval_ = geomSeries(out + i, k, oldval_, step_);
 
-					phase_ += freq_;
-					--framesToFill;
+					i += k;
+					framesToFill -= k;
 				}
 			} else {
 				for (int i = 0; i < n; ++i) {
@@ -699,7 +838,7 @@ struct Curves : public Gen
 			}
 
 			if (rateStride == 0) {
-				for (int i = 0; i < n; ++i) {
+				for (int i = 0; i < n;) {
 					while (phase_ >= dur_) {
 						phase_ -= dur_;
 						do {
@@ -718,12 +857,15 @@ struct Curves : public Gen
 						step_ = exp(curve_ * freq_ * invdur_);
 					}
 
-					out[i] = oldval_;
-					b1_ *= step_;
+					// render the rest of the segment. the curve is a2 - b1 * step^i.
+					int k = advancePhase(phase_, dur_, freq_, n - i);
+					Z* seg = out + i;
+					b1_ = geomSeries(seg, k, b1_, step_);
+					for (int j = 0; j < k; ++j) seg[j] = a2_ - seg[j];
 					oldval_ = a2_ - b1_;
 
-					phase_ += freq_;
-					--framesToFill;
+					i += k;
+					framesToFill -= k;
 				}
 			} else {
                 //!! not correct
@@ -801,28 +943,67 @@ struct Cubics : public Gen
 				break;
 			}
 
-			for (int i = 0; i < n; ++i) {
-				while (x >= 1.) {
-					x -= 1.;
-					y0 = y1;
-					y1 = y2;
-					y2 = y3;
-					if (vals_.onez(th, y3)) {
-						setDone();
-						goto leave;
-					} else {
-						c0 = y1;
-						c1 = .5 * (y2 - y0);
-						c2 = y0 - 2.5 * y1 + 2. * y2 - .5 * y3;
-						c3 = 1.5 * (y1 - y2) + .5 * (y3 - y0);
+			if (rateStride == 0) {
+				Z inc = *rate * freqmul;
+				for (int i = 0; i < n;) {
+					while (x >= 1.) {
+						x -= 1.;
+						y0 = y1;
+						y1 = y2;
+						y2 = y3;
+						if (vals_.onez(th, y3)) {
+							setDone();
+							goto leave;
+						} else {
+							c0 = y1;
+							c1 = .5 * (y2 - y0);
+							c2 = y0 - 2.5 * y1 + 2. * y2 - .5 * y3;
+							c3 = 1.5 * (y1 - y2) + .5 * (y3 - y0);
+						}
+					}
+
+					// render the rest of the segment. x is still summed a frame at a time, so the segment
+					// ends on the same frame, then the polynomial is evaluated over the whole run.
+					Z* seg = out + i;
+					int k = 0;
+					do {
+						seg[k++] = x;
+						x += inc;
+					} while (k < n - i && x < 1.);
+					
+					Z a0 = c0, a1 = c1, a2 = c2, a3 = c3;
+					for (int j = 0; j < k; ++j) {
+						Z t = seg[j];
+						seg[j] = ((a3 * t + a2) * t + a1) * t + a0;
 					}
+
+					i += k;
+					framesToFill -= k;
 				}
+			} else {
+				for (int i = 0; i < n; ++i) {
+					while (x >= 1.) {
+						x -= 1.;
+						y0 = y1;
+						y1 = y2;
+						y2 = y3;
+						if (vals_.onez(th, y3)) {
+							setDone();
+							goto leave;
+						} else {
+							c0 = y1;
+							c1 = .5 * (y2 - y0);
+							c2 = y0 - 2.5 * y1 + 2. * y2 - .5 * y3;
+							c3 = 1.5 * (y1 - y2) + .5 * (y3 - y0);
+						}
+					}
 
-				out[i] = ((c3 * x + c2) * x + c1) * x + c0;
+					out[i] = ((c3 * x + c2) * x + c1) * x + c0;
 
-				x += *rate * freqmul;
-				rate += rateStride;
-				--framesToFill;
+					x += *rate * freqmul;
+					rate += rateStride;
+					--framesToFill;
+				}
 			}
 			out += n;
 			rate_.advance(n);
@@ -862,7 +1043,7 @@ struct Tempo : public Gen
 {
 	BothIn vals_;
 	ZIn rate_;
-	Z beat_ = 0.;
+	SampleClock beat_;
 	Z dur_ = 0.;
 	Z lastTime_ = 0.;
 	Z nextTime_ = 0.;
@@ -897,19 +1078,23 @@ struct Tempo : public Gen
 				break;
 			}
 
-			for (int i = 0; i < n; ++i) {
-				// numerically it would be better to subtract off dur each time, but we need to recreate the same loss of precision over time
-				// as will be experienced from an integration of tempo occuring outside of this generator. otherwise there would be a drift
-				// between when tempo changes occur and the beat time as integrated from the tempo.
-				while (beat_ >= nextTime_) {
+			SampleClock beat = beat_; // a local copy stays in registers.
+			for (int i = 0; i < n;) {
+				// beat time must advance exactly as it will when this tempo is integrated by Beats, which also uses a SampleClock.
+				// otherwise there would be a drift between when tempo changes occur and the beat time as integrated from the tempo.
+				while (beat.now() >= nextTime_) {
 					do {
 						r0_ = r1_;
 						if (vals_.onez(th, dur_)) {
 							setDone();
+							beat_ = beat;
+							framesToFill -= i;
 							goto leave;
 						}
 						if (vals_.onez(th, r1_)) {
 							setDone();
+							beat_ = beat;
+							framesToFill -= i;
 							goto leave;
 						}
 					} while (dur_ <= 0.);
@@ -918,14 +1103,29 @@ struct Tempo : public Gen
 					nextTime_ += dur_;
 				}
 
-				Z tempo = *rate * (r0_ + (beat_ - lastTime_) * c_);
-				out[i] = tempo;
-				beat_ += tempo * invsr_;
-
-				rate += rateStride;
-				--framesToFill;
+				if (c_ == 0. && rateStride == 0) {
+					// steady tempo. skip to the next change.
+					Z tempo = *rate * r0_;
+					beat.setRate(tempo * invsr_);
+					int k = std::max(1, beat.framesUntil(nextTime_, n - i));
+					vDSP_vfillD(&tempo, out + i, 1, k);
+					beat.advance(k);
+					i += k;
+				} else {
+					// ramp or signal rate. run to the next change.
+					Z r0 = r0_, c = c_, lastTime = lastTime_, nextTime = nextTime_, invsr = invsr_;
+					do {
+						Z tempo = rate[i * rateStride] * (r0 + (beat.now() - lastTime) * c);
+						out[i] = tempo;
+						beat.setRate(tempo * invsr);
+						beat.advance(1);
+						++i;
+					} while (i < n && beat.now() < nextTime);
+				}
 			}
+			beat_ = beat;
 
+			framesToFill -= n;
 			out += n;
 			rate_.advance(n);
 		}
@@ -938,7 +1138,7 @@ leave:
 struct Beats : public Gen
 {
 	ZIn tempo_;
-	Z beat_ = 0.;
+	SampleClock beat_;
 	Z invsr_;
 
 	Beats(Thread& th, Arg tempo) : Gen(th, itemTypeZ, tempo.isFinite()), tempo_(tempo),
@@ -953,7 +1153,6 @@ struct Beats : public Gen
 
 		Z* out = mOut->fulfillz(mBlockSize);
 		int framesToFill = mBlockSize;
-		Z beat = beat_;
 		while (framesToFill) {
 			Z* tempo;
 			int n = framesToFill;
@@ -964,16 +1163,22 @@ struct Beats : public Gen
 			}
 
 			Z invsr = invsr_;
-			for (int i = 0; i < n; ++i) {
-				out[i] = beat;
-				beat += *tempo * invsr;
-				tempo += tempoStride;
+			if (tempoStride == 0) {
+				beat_.setRate(*tempo * invsr);
+				beat_.fill(out, n);
+			} else {
+				SampleClock beat = beat_; // a local copy stays in registers.
+				for (int i = 0; i < n; ++i) {
+					beat.setRate(tempo[i] * invsr);
+					out[i] = beat.now();
+					beat.advance(1);
+				}
+				beat_ = beat;
 			}
 			framesToFill -= n;
 			out += n;
 			tempo_.advance(n);
 		}
-		beat_ = beat;
 		produce(framesToFill);
 	}
 };
@@ -1036,6 +1241,41 @@ struct ADSR : public Gen
 		}
 	}
 
+	// take any stage transitions that are due at the current frame. returns false when the envelope has ended.
+	bool nextStage()
+	{
+		while (1) {
+			if (stage_ < sustainStage_) {
+				if (phase_ >= dur_) {
+					phase_ -= dur_;
+					++stage_;
+				} else if (beat_ >= noteOff_) {
+					phase_ = 0.;
+					stage_ = sustainStage_+1; // go into release mode
+				} else break;
+			} else if (stage_ == sustainStage_) {
+				if (beat_ >= noteOff_) {
+					phase_ = 0.;
+					stage_ = sustainStage_+1;
+				} else break;
+			} else if (stage_ < NumStages){
+				if (phase_ >= dur_) {
+					phase_ -= dur_;
+					++stage_;
+				} else break;
+			} else {
+				return false;
+			}
+								
+			newval_ = levels_[stage_+1];
+			curve_ = curves_[stage_];
+			dur_ = durs_[stage_];
+			
+			calcStep();
+		}
+		return true;
+	}
+
 	virtual void pull(Thread& th) override
 	{
 		Z* out = mOut->fulfillz(mBlockSize);
@@ -1049,61 +1289,42 @@ struct ADSR : public Gen
 				break;
 			}
 			
-			// rework this loop!!!
-			//adsr
-			//	if (stage < releaseStage) {
-			//		integrate tempo
-			//		search from end. break when < noteoff.
-			//		remember note off sample index.
-			//	}
-			//	
-			//	when there is a new stage and it is not the sustainStage
-			//	compute the number of samples in the stage
-			//	
-			//	limit n to the min(blockSize, stageSamplesRemaining, [noteOffSample])
-			//	after a stage 
-
+			// render a stage at a time. a stage ends when its duration has elapsed, or at the note off for stages before the release.
+			for (int i = 0; i < n;) {
+				if (!nextStage()) {
+					setDone();
+					goto leave;
+				}
 
-			for (int i = 0; i < n; ++i) {
-				while (1) {
-					if (stage_ < sustainStage_) {
-						if (phase_ >= dur_) {
-							phase_ -= dur_;
-							++stage_;
-						} else if (beat_ >= noteOff_) {
-							phase_ = 0.;
-							stage_ = sustainStage_+1; // go into release mode
-						} else break;
-					} else if (stage_ == sustainStage_) {
-						if (beat_ >= noteOff_) {
-							phase_ = 0.;
-							stage_ = sustainStage_+1;
-						} else break;
-					} else if (stage_ < NumStages){
-						if (phase_ >= dur_) {
-							phase_ -= dur_;
-							++stage_;
-						} else break;
-					} else {
-						setDone();
-						goto leave;
-					}					
-										
-					newval_ = levels_[stage_+1];
-					curve_ = curves_[stage_];
-					dur_ = durs_[stage_];
-					
-					calcStep();
+				// find the end of the stage. before the release, the tempo is integrated up to the note off.
+				int k = 0;
+				if (stage_ < sustainStage_) {
+					Z* r = rate + i * rateStride;
+					do {
+						phase_ += freqmul_;
+						beat_ += *r * freqmul_;
+						r += rateStride;
+						++k;
+					} while (i + k < n && phase_ < dur_ && beat_ < noteOff_);
+				} else if (stage_ == sustainStage_) {
+					Z* r = rate + i * rateStride;
+					do {
+						beat_ += *r * freqmul_;
+						r += rateStride;
+						++k;
+					} while (i + k < n && beat_ < noteOff_);
+				} else {
+					k = advancePhase(phase_, dur_, freqmul_, n - i);
 				}
 
-				out[i] = oldval_;
-				b1_ *= step_;
+				// the curve is a2 - b1 * step^i.
+				Z* seg = out + i;
+				b1_ = geomSeries(seg, k, b1_, step_);
+				for (int j = 0; j < k; ++j) seg[j] = a2_ - seg[j];
 				oldval_ = a2_ - b1_;
 
-				beat_ += *rate * freqmul_;
-				rate += rateStride;
-				phase_ += freqmul_;
-				--framesToFill;
+				i += k;
+				framesToFill -= k;
 			}
 			out += n;
 			rate_.advance(n);
@@ -1627,6 +1848,216 @@ static void krc_(Thread& th, Prim* prim)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// 2x resampling uses a half band lowpass. every other tap is zero apart from the center tap of 1/2,
+// so each stage only convolves with the 2K taps nearest the center, at the lower of its two rates.
+const int kHalfBandK = 12;
+const int kHalfBandTaps = 2 * kHalfBandK;
+
+// the nonzero odd taps of a Kaiser windowed half band lowpass, scaled by 2 for interpolation.
+static Z const* halfBandTaps()
+{
+	static std::vector<Z> taps = []() {
+		std::vector<Z> t(kHalfBandTaps);
+		P<Array> window = getWindow(kWindowKaiser, 2 * kHalfBandTaps - 1, 80.);
+		Z sum = 0.;
+		for (int p = 0; p < kHalfBandTaps; ++p) {
+			int k = 2 * p - kHalfBandTaps + 1;
+			t[p] = 2. * sin(.5 * M_PI * k) / (M_PI * k) * window->z()[k + kHalfBandTaps - 1];
+			sum += t[p];
+		}
+		// exactly unity gain at DC.
+		for (int p = 0; p < kHalfBandTaps; ++p) t[p] /= sum;
+		return t;
+	}();
+	return taps.data();
+}
+
+// one 2x interpolation stage. input is written at input(), after the history.
+struct HalfBandUp
+{
+	std::vector<Z> mBuf;
+	
+	HalfBandUp(int inMaxFrames) : mBuf(kHalfBandTaps - 1 + inMaxFrames, 0.) {}
+	
+	Z* input() { return mBuf.data() + kHalfBandTaps - 1; }
+	
+	// writes 2n frames from the n frames at input().
+	void process(int n, Z* out)
+	{
+		Z* buf = mBuf.data();
+		vDSP_convD(buf, 1, halfBandTaps(), 1, out + 1, 2, n, kHalfBandTaps);
+		for (int i = 0; i < n; ++i) {
+			out[2*i] = buf[kHalfBandK - 1 + i];
+		}
+		memmove(buf, buf + n, (kHalfBandTaps - 1) * sizeof(Z));
+	}
+};
+
+// one 2x decimation stage. input is written at input(), after the history.
+struct HalfBandDown
+{
+	std::vector<Z> mBuf;
+	Z mTaps[kHalfBandTaps];
+	
+	HalfBandDown(int inMaxFrames) : mBuf(2 * kHalfBandTaps - 2 + inMaxFrames, 0.)
+	{
+		Z half = .5;
+		vDSP_vsmulD(halfBandTaps(), 1, &half, mTaps, 1, kHalfBandTaps);
+	}
+	
+	Z* input() { return mBuf.data() + 2 * kHalfBandTaps - 2; }
+	
+	// writes n frames from the 2n frames at input().
+	void process(int n, Z* out)
+	{
+		Z* buf = mBuf.data();
+		Z half = .5;
+		vDSP_convD(buf + 1, 2, mTaps, 1, out, 1, n, kHalfBandTaps);
+		vDSP_vsmaD(buf + kHalfBandTaps, 2, &half, out, 1, out, 1, n);
+		memmove(buf, buf + 2 * n, (2 * kHalfBandTaps - 2) * sizeof(Z));
+	}
+};
+
+static int numHalfBandStages(int factor)
+{
+	return factor == 8 ? 3 : factor == 4 ? 2 : 1;
+}
+
+// runs at the oversampled rate.
+struct Upsample : public Gen
+{
+	ZIn _in;
+	int _factor;
+	std::vector<HalfBandUp> _stages;
+
+	Upsample(Thread& th, Arg in, int factor)
+		: Gen(th, itemTypeZ, in.isFinite()), _in(in), _factor(factor)
+	{
+		int frames = mBlockSize / factor;
+		for (int i = 0; i < numHalfBandStages(factor); ++i, frames *= 2) {
+			_stages.emplace_back(frames);
+		}
+	}
+
+	virtual const char* TypeName() const override { return "Upsample"; }
+
+	virtual void pull(Thread& th) override
+	{
+		int framesToFill = mBlockSize;
+		Z* out = mOut->fulfillz(framesToFill);
+		int n = framesToFill / _factor;
+		bool done = _in.fill(th, n, _stages[0].input(), 1);
+		int numStages = (int)_stages.size();
+		for (int i = 0; i < numStages; ++i, n *= 2) {
+			_stages[i].process(n, i + 1 < numStages ? _stages[i+1].input() : out);
+		}
+		framesToFill -= n;
+		if (done) setDone();
+		produce(framesToFill);
+	}
+};
+
+// runs at the outer rate.
+struct Downsample : public Gen
+{
+	ZIn _in;
+	int _factor;
+	std::vector<HalfBandDown> _stages;
+
+	Downsample(Thread& th, Arg in, int factor)
+		: Gen(th, itemTypeZ, in.isFinite()), _in(in), _factor(factor)
+	{
+		int frames = mBlockSize * factor;
+		for (int i = 0; i < numHalfBandStages(factor); ++i, frames /= 2) {
+			_stages.emplace_back(frames);
+		}
+	}
+
+	virtual const char* TypeName() const override { return "Downsample"; }
+
+	virtual void pull(Thread& th) override
+	{
+		int framesToFill = mBlockSize;
+		Z* out = mOut->fulfillz(framesToFill);
+		int filled = framesToFill * _factor;
+		bool done = _in.fill(th, filled, _stages[0].input(), 1);
+		// at the end of the input, fill shortens filled and pads the rest with zeros. the
+		// stages halve n, so it is rounded up to whole output frames.
+		int n = (filled + _factor - 1) / _factor * _factor;
+		int numStages = (int)_stages.size();
+		for (int i = 0; i < numStages; ++i) {
+			n /= 2;
+			_stages[i].process(n, i + 1 < numStages ? _stages[i+1].input() : out);
+		}
+		framesToFill -= n;
+		if (done) setDone();
+		produce(framesToFill);
+	}
+};
+
+static void downsample_(Thread& th, Prim* prim)
+{
+	int factor = (int)th.popInt("oversample : factor");
+	V a = th.popZIn("oversample : signal");
+	
+	th.push(new List(new Downsample(th, a, factor)));
+}
+
+P<Prim> gDownsample;
+
+static void oversample_(Thread& th, Prim* prim)
+{
+	int64_t factor = th.popInt("oversample : factor");
+	V fun = th.pop();
+	V in = th.pop();
+	
+	if (factor != 2 && factor != 4 && factor != 8) {
+		post("oversample : factor must be 2, 4 or 8\n");
+		throw errOutOfRange;
+	}
+	
+	// a finite list of signals is upsampled as separate arguments to fun.
+	std::vector<V> ins;
+	if (in.isVList()) {
+		if (!in.isFinite()) indefiniteOp("oversample : in", "");
+		P<List> list = ((List*)in.o())->pack(th);
+		Array* a = list->mArray();
+		for (int64_t i = 0; i < a->size(); ++i) {
+			V v = a->at(i);
+			if (!v.isZIn()) wrongType("oversample : in", "signal or list of signals", v);
+			ins.push_back(v);
+		}
+	} else if (in.isZIn()) {
+		ins.push_back(in);
+	} else {
+		wrongType("oversample : in", "signal or list of signals", in);
+	}
+	
+	V result;
+	{
+		SaveStack ss(th);
+		Rate overRate(th.rate, 1, (int)factor);
+		{
+			UseRate ur(th, overRate);
+			for (V& v : ins) {
+				th.push(new List(new Upsample(th, v, (int)factor)));
+			}
+			fun.apply(th);
+		}
+		result = th.pop();
+		{
+			SaveStack ss2(th);
+			th.push(result);
+			th.push(factor);
+			gDownsample->apply_n(th, 2);
+			result = th.pop();
+		}
+	}
+	th.push(result);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 struct LFNoise0 : public Gen
 {
 	ZIn rate_;
@@ -1818,14 +2249,16 @@ static void lfnoise3_(Thread& th, Prim* prim)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
+// an envelope that is a function of x as x goes from -scale to +scale over the duration.
+// calc is passed the output filled with the x value of each frame and replaces them with the envelope.
 template <class F>
 struct SymmetricEnv : public Gen
 {
 	Z xinc;
-	Z x;
+	Z x_;
 	int64_t n_;
 	
-	SymmetricEnv<F>(Thread& th, Z dur, Z scale) : Gen(th, itemTypeZ, true), x(-scale)
+	SymmetricEnv<F>(Thread& th, Z dur, Z scale) : Gen(th, itemTypeZ, true), x_(-scale)
 	{
 		Z n = std::max(1., floor(dur * th.rate.sampleRate + .5));
 		n_ = (int64_t)n;
@@ -1836,6 +2269,8 @@ struct SymmetricEnv : public Gen
 	{
 		int n = (int)std::min(n_, (int64_t)mBlockSize);
 		Z* out = mOut->fulfillz(n);
+		vDSP_vrampD(&x_, &xinc, out, 1, n);
+		x_ += n * xinc;
 		static_cast<F*>(this)->F::calc(n, out);
 		mOut = mOut->nextp();
 		n_ -= n;
@@ -1852,7 +2287,7 @@ struct TriggeredSymmetricEnv : public Gen
 	BothIn dur_;
 	BothIn amp_;
 	Z xinc;
-	Z x;
+	Z x_;
 	Z scale_;
 	Z ampval_;
 	int64_t n_ = 0;
@@ -1862,6 +2297,13 @@ struct TriggeredSymmetricEnv : public Gen
 	{
 	}
 
+	void render(int n, Z* out)
+	{
+		vDSP_vrampD(&x_, &xinc, out, 1, n);
+		x_ += n * xinc;
+		static_cast<F*>(this)->F::calc(n, ampval_, out);
+	}
+
 	virtual void pull(Thread& th) override
 	{
 		Z* out = mOut->fulfillz(mBlockSize);
@@ -1876,7 +2318,7 @@ struct TriggeredSymmetricEnv : public Gen
 			}
 			if (n_) {
 				n = (int)std::min((int64_t)n, n_);
-				static_cast<F*>(this)->F::calc(n, ampval_, out);
+				render(n, out);
 				n_ -= n;
 				trig += n * trigStride;
 			} else {
@@ -1893,12 +2335,12 @@ struct TriggeredSymmetricEnv : public Gen
 							produce(framesToFill - i);
 							return;
 						}
-						x = -scale_;
+						x_ = -scale_;
 						Z zn = std::max(1., floor(dur * th.rate.sampleRate + .5));
 						n_ = (int64_t)zn;
 						xinc = 2. * scale_ / zn;
 						int n2 = (int)std::min((int64_t)(n-i), n_);
-						static_cast<F*>(this)->F::calc(n2, ampval_, out+i);
+						render(n2, out+i);
 						n_ -= n2;
 						trig += n2 * trigStride;
 						i += n2;
@@ -2037,9 +2479,9 @@ struct ParEnv : public SymmetricEnv<ParEnv>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z x2 = x*x;
 			out[i] = 1. - x2;
-			x += xinc;
 		}
 	}
 };
@@ -2060,9 +2502,9 @@ struct TParEnv : public TriggeredSymmetricEnv<TParEnv>
 	virtual void calc(int n, Z amp, Z* out)
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z x2 = x*x;
 			out[i] = amp * (1. - x2);
-			x += xinc;
 		}
 	}
 };
@@ -2085,9 +2527,9 @@ struct QuadEnv : public SymmetricEnv<QuadEnv>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z x2 = x*x;
 			out[i] = 1. - x2*x2;
-			x += xinc;
 		}
 	}
 };
@@ -2108,9 +2550,9 @@ struct TQuadEnv : public TriggeredSymmetricEnv<TQuadEnv>
 	virtual void calc(int n, Z amp, Z* out)
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z x2 = x*x;
 			out[i] = amp * (1. - x2*x2);
-			x += xinc;
 		}
 	}
 };
@@ -2134,12 +2576,12 @@ struct OctEnv : public SymmetricEnv<OctEnv>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z x2 = x*x;
 			Z x4 = x2*x2;
 			
 			out[i] = 1. - x4*x4;
 			
-			x += xinc;
 		}
 	}
 };
@@ -2160,10 +2602,10 @@ struct TOctEnv : public TriggeredSymmetricEnv<TOctEnv>
 	virtual void calc(int n, Z amp, Z* out)
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z x2 = x*x;
 			Z x4 = x2*x2;
 			out[i] = amp * (1. - x4*x4);
-			x += xinc;
 		}
 	}
 };
@@ -2186,8 +2628,8 @@ struct TriEnv : public SymmetricEnv<TriEnv>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			out[i] = 1. - fabs(x);
-			x += xinc;
 		}
 	}
 };
@@ -2208,8 +2650,8 @@ struct TTriEnv : public TriggeredSymmetricEnv<TTriEnv>
 	virtual void calc(int n, Z amp, Z* out)
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			out[i] = amp * (1. - fabs(x));
-			x += xinc;
 		}
 	}
 };
@@ -2232,9 +2674,9 @@ struct Tri2Env : public SymmetricEnv<Tri2Env>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z y = 1. - fabs(x);
 			out[i] = y*y;
-			x += xinc;
 		}
 	}
 };
@@ -2255,9 +2697,9 @@ struct TTri2Env : public TriggeredSymmetricEnv<TTri2Env>
 	virtual void calc(int n, Z amp, Z* out)
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z y = 1. - fabs(x);
 			out[i] = amp * y*y;
-			x += xinc;
 		}
 	}
 };
@@ -2281,8 +2723,8 @@ struct TrapezEnv : public SymmetricEnv<TrapezEnv>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			out[i] = 2. - fabs(x-.5) - fabs(x+.5);
-			x += xinc;
 		}
 	}
 };
@@ -2304,9 +2746,9 @@ struct TTrapezEnv : public TriggeredSymmetricEnv<TTrapezEnv>
 	virtual void calc(int n, Z amp, Z* out)
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z y = 2. - fabs(x-.5) - fabs(x+.5);
 			out[i] = amp * y;
-			x += xinc;
 		}
 	}
 };
@@ -2330,9 +2772,9 @@ struct Trapez2Env : public SymmetricEnv<Trapez2Env>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z y = 2. - fabs(x-.5) - fabs(x+.5);
 			out[i] = y*y;
-			x += xinc;
 		}
 	}
 };
@@ -2353,9 +2795,9 @@ struct TTrapez2Env : public TriggeredSymmetricEnv<TTrapez2Env>
 	virtual void calc(int n, Z amp, Z* out)
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			Z y = 2. - fabs(x-.5) - fabs(x+.5);
 			out[i] = amp * y*y;
-			x += xinc;
 		}
 	}
 };
@@ -2379,10 +2821,7 @@ struct CosEnv : public SymmetricEnv<CosEnv>
 	
 	virtual void calc(int n, Z* out) 
 	{
-		for (int i = 0; i < n; ++i) {
-			out[i] = cos(x);
-			x += xinc;
-		}
+		vvcos(out, out, &n);
 	}
 };
 
@@ -2402,10 +2841,8 @@ struct TCosEnv : public TriggeredSymmetricEnv<TCosEnv>
 	
 	virtual void calc(int n, Z amp, Z* out)
 	{
-		for (int i = 0; i < n; ++i) {
-			out[i] = amp * cos(x);
-			x += xinc;
-		}
+		vvcos(out, out, &n);
+		vDSP_vsmulD(out, 1, &amp, out, 1, n);
 	}
 };
 
@@ -2428,10 +2865,10 @@ struct HanEnv : public SymmetricEnv<HanEnv>
 	
 	virtual void calc(int n, Z* out) 
 	{
+		vvcos(out, out, &n);
 		for (int i = 0; i < n; ++i) {
-			Z y = cos(x);
+			Z y = out[i];
 			out[i] = y*y;
-			x += xinc;
 		}
 	}
 };
@@ -2452,10 +2889,10 @@ struct THanEnv : public TriggeredSymmetricEnv<THanEnv>
 	
 	virtual void calc(int n, Z amp, Z* out)
 	{
+		vvcos(out, out, &n);
 		for (int i = 0; i < n; ++i) {
-			Z y = cos(x);
+			Z y = out[i];
 			out[i] = amp * y*y;
-			x += xinc;
 		}
 	}
 };
@@ -2479,11 +2916,11 @@ struct Han2Env : public SymmetricEnv<Han2Env>
 	
 	virtual void calc(int n, Z* out) 
 	{
+		vvcos(out, out, &n);
 		for (int i = 0; i < n; ++i) {
-			Z y = cos(x);
+			Z y = out[i];
 			Z y2 = y*y;
 			out[i] = y2*y2;
-			x += xinc;
 		}
 	}
 };
@@ -2504,11 +2941,11 @@ struct THan2Env : public TriggeredSymmetricEnv<THan2Env>
 	
 	virtual void calc(int n, Z amp, Z* out)
 	{
+		vvcos(out, out, &n);
 		for (int i = 0; i < n; ++i) {
-			Z y = cos(x);
+			Z y = out[i];
 			Z y2 = y*y;
 			out[i] = amp * y2*y2;
-			x += xinc;
 		}
 	}
 };
@@ -2534,8 +2971,8 @@ struct GaussEnv : public SymmetricEnv<GaussEnv>
 	virtual void calc(int n, Z* out) 
 	{
 		for (int i = 0; i < n; ++i) {
+			Z x = out[i];
 			out[i] = exp(x * x * widthFactor);
-			x += xinc;
 		}
 	}
 };
@@ -2672,7 +3109,7 @@ protected:
 	VIn mSounds;
 	BothIn mHops;
 	ZIn mRate;
-	Z mBeatTime;
+	SampleClock mBeatTime;
 	Z mNextEventBeatTime;
 	Z mEventCounter;
 	Z mRateMul;
@@ -2680,6 +3117,9 @@ protected:
 	int64_t mPrevChaseTime;
 	
 	P<Form> mChasedSignals;
+	
+	uint64_t mOutCache = 0;
+	uint64_t mDtCache = 0;
 
 public:
 	OverlapAdd(Thread& th, Arg sounds, Arg hops, Arg rate, P<Form> const& chasedSignals, int numChannels);
@@ -2769,7 +3209,7 @@ OverlapAddBase::~OverlapAddBase()
 OverlapAdd::OverlapAdd(Thread& th, Arg sounds, Arg hops, Arg rate, P<Form> const& chasedSignals, int numChannels)
 	: OverlapAddBase(numChannels),
     mSounds(sounds), mHops(hops), mRate(rate),
-	mBeatTime(0.), mNextEventBeatTime(0.), mEventCounter(0.), mRateMul(th.rate.invSampleRate),
+	mNextEventBeatTime(0.), mEventCounter(0.), mRateMul(th.rate.invSampleRate),
 	mSampleTime(0), mPrevChaseTime(0),
 	mChasedSignals(chasedSignals)
 {
@@ -2801,11 +3241,12 @@ void OverlapAdd::addNewSources(Thread& th, int blockSize)
 	if (mRate(th, blockSize, rateStride, rate)) {
 		mNoMoreSources = true;
 	} else if (!mNoMoreSources) {
-		Z beatTime = mBeatTime;
 		Z nextEventBeatTime = mNextEventBeatTime;
 		Z ratemul = mRateMul;
+		if (rateStride == 0) mBeatTime.setRate(*rate * ratemul);
 		for (int i = 0; i < blockSize; ++i) {
-			while (beatTime >= nextEventBeatTime) {
+			if (rateStride) mBeatTime.setRate(rate[i * rateStride] * ratemul);
+			while (mBeatTime.now() >= nextEventBeatTime) {
 			
 				chaseToTime(th, mSampleTime + i);
 			
@@ -2836,9 +3277,10 @@ void OverlapAdd::addNewSources(Thread& th, int blockSize)
 						parents[1] = newSource;
 						newSource = linearizeInheritance(th, 2, parents);
 					}
-					newSource.dot(th, s_out, out);
+					Form* form = (Form*)newSource.o();
+					form->dotCached(th, s_out, mOutCache, out);
 					V hop;
-					if (newSource.dot(th, s_dt, hop) && hop.isReal()) {
+					if (form->dotCached(th, s_dt, mDtCache, hop) && hop.isReal()) {
 						deltaTime = hop.f;
 					}
 
@@ -2857,10 +3299,14 @@ void OverlapAdd::addNewSources(Thread& th, int blockSize)
 				nextEventBeatTime += deltaTime;
 				mEventCounter += 1.;
 			}
-			beatTime += *rate * ratemul;
-			rate += rateStride;
+			mBeatTime.advance(1);
+			if (rateStride == 0 && !mNoMoreSources) {
+				// skip to the sample before the next event.
+				int k = mBeatTime.framesUntil(nextEventBeatTime, blockSize - i - 1);
+				mBeatTime.advance(k);
+				i += k;
+			}
 		}
-		mBeatTime = beatTime;
 		mNextEventBeatTime = nextEventBeatTime;
 		mSampleTime += blockSize;
 		
@@ -3740,64 +4186,678 @@ static void fade2_(Thread& th, Prim* prim)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-struct Trig : public Gen
+// A MatrixMix mixes N input signals to M outputs through an N x M gain matrix.
+// Subclasses compute the matrix from the control inputs, which are sampled once every kMatrixControlPeriod frames.
+// When the controls change, the gains ramp linearly to the new matrix over the following period.
+
+const int kMatrixControlPeriod = 32;
+
+struct MatrixMixOut;
+
+struct MatrixMix : public Object
 {
-	ZIn _in;
-	Z _prev;
+	std::vector<ZIn> mIns;
+	std::vector<ZIn> mControls;
+	std::vector<MatrixMixOut*> mOuts;
 	
-	Trig(Thread& th, Arg in)
-		: Gen(th, itemTypeZ, in.isFinite()), _in(in), _prev(0.)
+	std::vector<Z> mControlValues;
+	std::vector<Z> mPrevControls;
+	std::vector<Z> mGains; // mGains[i * numOuts + j] is the gain from input i to output j.
+	std::vector<Z> mTargets;
+	std::vector<Z*> mInPtrs;
+	std::vector<int> mInStrides;
+	std::vector<Z*> mOutPtrs;
+	bool mStarted = false;
+	
+	MatrixMix(Thread& th, std::vector<ZIn> const& inIns, std::vector<ZIn> const& inControls, int inNumOuts)
+		: mIns(inIns), mControls(inControls),
+		mControlValues(inControls.size()),
+		mGains(inIns.size() * inNumOuts), mTargets(inIns.size() * inNumOuts),
+		mInPtrs(inIns.size()), mInStrides(inIns.size()), mOutPtrs(inNumOuts)
 	{
+		mOuts.reserve(inNumOuts);
+		finite = false;
+		for (auto& in : mIns) finite = finite || (!in.isConstant() && in.mList->isFinite());
+		for (auto& in : mControls) finite = finite || (!in.isConstant() && in.mList->isFinite());
 	}
 	
-	virtual const char* TypeName() const override { return "Trig"; }
+	int numIns() const { return (int)mIns.size(); }
+	int numOuts() const { return (int)mOutPtrs.size(); }
+	
+	// fill outGains from mControlValues.
+	virtual void calcGains(Z* outGains) = 0;
+
+	P<List> createOutputs(Thread& th);
+	
+	virtual void pull(Thread& th);
+	
+private:
+	bool readInputs(Thread& th, int& n);
+	void advanceInputs(int n);
+};
+
+struct MatrixMixOut : public Gen
+{
+	P<MatrixMix> mMix;
+	
+	MatrixMixOut(Thread& th, bool inFinite, P<MatrixMix> const& inMix) : Gen(th, itemTypeZ, inFinite), mMix(inMix)
+	{
+	}
+
+	virtual void norefs() override
+	{
+		mOut = nullptr;
+		mMix = nullptr;
+	}
+	
+	virtual const char* TypeName() const override { return "MatrixMixOut"; }
 	
 	virtual void pull(Thread& th) override
 	{
-		int framesToFill = mBlockSize;
+		mMix->pull(th);
+	}
+};
+
+P<List> MatrixMix::createOutputs(Thread& th)
+{
+	P<List> s = new List(itemTypeV, numOuts());
+	P<Array> a = s->mArray;
+	for (int j = 0; j < numOuts(); ++j) {
+		MatrixMixOut* out = new MatrixMixOut(th, finite, this);
+		mOuts.push_back(out);
+		P<Gen> gen = out;
+		a->add(new List(gen));
+	}
+	return s;
+}
+
+bool MatrixMix::readInputs(Thread& th, int& n)
+{
+	for (int i = 0; i < numIns(); ++i) {
+		if (mIns[i](th, n, mInStrides[i], mInPtrs[i])) return true;
+	}
+	for (size_t k = 0; k < mControls.size(); ++k) {
+		Z* z;
+		int stride;
+		if (mControls[k](th, n, stride, z)) return true;
+		mControlValues[k] = *z;
+	}
+	return false;
+}
+
+void MatrixMix::advanceInputs(int n)
+{
+	for (auto& in : mIns) in.advance(n);
+	for (auto& in : mControls) in.advance(n);
+}
+
+static void mixRamp(Z* out, const Z* in, int inStride, int n, Z start, Z end)
+{
+	if (inStride == 0) {
+		Z z = *in;
+		Z step = (end - start) * z / n;
+		Z g = start * z;
+		for (int k = 0; k < n; ++k) {
+			out[k] += g;
+			g += step;
+		}
+	} else if (start == end) {
+		vDSP_vsmaD(in, inStride, &end, out, 1, out, 1, n);
+	} else {
+		Z step = (end - start) / n;
+		vDSP_vrampmuladdD(in, inStride, &start, &step, out, 1, n);
+	}
+}
+
+void MatrixMix::pull(Thread& th)
+{
+	int framesToFill = mOuts[0]->mBlockSize;
+	int M = numOuts();
+	int N = numIns();
+	
+	for (int j = 0; j < M; ++j) {
+		MatrixMixOut* out = mOuts[j];
+		if (out->mOut) {
+			mOutPtrs[j] = out->mOut->fulfillz(framesToFill);
+			vDSP_vclrD(mOutPtrs[j], 1, framesToFill);
+		} else {
+			mOutPtrs[j] = nullptr;
+		}
+	}
+
+	while (framesToFill) {
+		int n = std::min(framesToFill, kMatrixControlPeriod);
+		if (readInputs(th, n)) {
+			for (auto out : mOuts) out->setDone();
+			break;
+		}
 		
-		Z* out = mOut->fulfillz(framesToFill);
-		Z prev = _prev;
-		while (framesToFill) {
-			Z *in;
-			int n, inStride;
-			n = framesToFill;
-			if (_in(th, n, inStride, in)) {
-				setDone();
-				break;
+		// gains are only recalculated when the controls have moved.
+		bool ramp = false;
+		if (!mStarted || mPrevControls != mControlValues) {
+			calcGains(mTargets.data());
+			if (!mStarted) {
+				mGains = mTargets;
+				mStarted = true;
 			}
-			
-			for (int i = 0; i < n; ++i) {
-				
-				Z cur = *in;
-				out[i] = cur > 0. && prev <= 0. ? 1. : 0.;
-				prev = cur;
-				in += inStride;
+			mPrevControls = mControlValues;
+			ramp = mGains != mTargets;
+		}
+
+		for (int i = 0; i < N; ++i) {
+			Z* in = mInPtrs[i];
+			int inStride = mInStrides[i];
+			Z* g0 = mGains.data() + i * M;
+			Z* g1 = mTargets.data() + i * M;
+			for (int j = 0; j < M; ++j) {
+				Z* out = mOutPtrs[j];
+				if (!out || (g0[j] == 0. && g1[j] == 0.)) continue;
+				mixRamp(out, in, inStride, n, g0[j], g1[j]);
+			}
+		}
+		if (ramp) mGains = mTargets;
+		
+		for (int j = 0; j < M; ++j) {
+			if (mOutPtrs[j]) mOutPtrs[j] += n;
+		}
+		framesToFill -= n;
+		advanceInputs(n);
+	}
+	for (auto out : mOuts) {
+		if (out->mOut) out->produce(framesToFill);
+	}
+}
+
+static std::vector<ZIn> popChannels(Thread& th, const char* msg)
+{
+	V v = th.popZInList(msg);
+	std::vector<ZIn> channels;
+	if (v.isVList()) {
+		if (!v.isFinite())
+			indefiniteOp(msg, " - indefinite number of channels");
+		P<List> s = ((List*)v.o())->pack(th);
+		Array* a = s->mArray();
+		channels.reserve(a->size());
+		for (int i = 0; i < a->size(); ++i) {
+			V va = a->at(i);
+			if (!va.isZIn()) wrongType(msg, "Real or Signal", va);
+			channels.push_back(ZIn(va));
+		}
+	} else {
+		channels.push_back(ZIn(v));
+	}
+	return channels;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// two dimensional vector base amplitude panning.
+// each source is panned between the two adjacent speakers that enclose it.
+// a pair of speakers 180 degrees or more apart has no vector base, so it is equal power panned by angle instead.
+
+struct VBAP : public MatrixMix
+{
+	std::vector<int> mOrder; // speaker indices sorted by angle
+	std::vector<Z> mAngles;  // sorted speaker angles in radians from 0 to 2pi
+	std::vector<Z> mCos;
+	std::vector<Z> mSin;
+	
+	VBAP(Thread& th, std::vector<ZIn> const& inSources, std::vector<ZIn> const& inAzimuths, Array* inSpeakers)
+		: MatrixMix(th, inSources, inAzimuths, (int)inSpeakers->size())
+	{
+		int M = numOuts();
+		mOrder.resize(M);
+		for (int j = 0; j < M; ++j) mOrder[j] = j;
+		std::vector<Z> angles(M);
+		for (int j = 0; j < M; ++j) angles[j] = wrapAngle(M_PI * inSpeakers->atz(j));
+		std::sort(mOrder.begin(), mOrder.end(), [&](int a, int b) { return angles[a] < angles[b]; });
+		
+		for (int j = 0; j < M; ++j) {
+			Z a = angles[mOrder[j]];
+			mAngles.push_back(a);
+			mCos.push_back(cos(a));
+			mSin.push_back(sin(a));
+		}
+	}
+	
+	virtual const char* TypeName() const override { return "VBAP"; }
+
+	static Z wrapAngle(Z a)
+	{
+		a = fmod(a, 2. * M_PI);
+		return a < 0. ? a + 2. * M_PI : a;
+	}
+	
+	virtual void calcGains(Z* outGains) override
+	{
+		int M = numOuts();
+		for (int i = 0; i < numIns(); ++i) {
+			Z* g = outGains + i * M;
+			std::fill(g, g + M, 0.);
+			if (M == 1) {
+				g[0] = 1.;
+				continue;
 			}
 			
-			framesToFill -= n;
-			out += n;
-			_in.advance(n);
+			// find the pair k, k+1 whose arc contains the source.
+			Z theta = wrapAngle(M_PI * mControlValues[i]);
+			int k = (int)(std::upper_bound(mAngles.begin(), mAngles.end(), theta) - mAngles.begin()) - 1;
+			if (k < 0) k = M - 1;
+			int k2 = k + 1 == M ? 0 : k + 1;
+
+			Z arc = wrapAngle(mAngles[k2] - mAngles[k]);
+			Z g1, g2;
+			if (arc == 0.) {
+				arc = 2. * M_PI; // all speakers coincide.
+			}
+			if (arc < M_PI - 1e-6) {
+				Z px = cos(theta);
+				Z py = sin(theta);
+				Z det = mCos[k] * mSin[k2] - mSin[k] * mCos[k2];
+				g1 = std::max(0., (px * mSin[k2] - py * mCos[k2]) / det);
+				g2 = std::max(0., (py * mCos[k] - px * mSin[k]) / det);
+				Z norm = hypot(g1, g2);
+				if (norm > 0.) {
+					g1 /= norm;
+					g2 /= norm;
+				}
+			} else {
+				Z x = .5 * M_PI * wrapAngle(theta - mAngles[k]) / arc;
+				g1 = cos(x);
+				g2 = sin(x);
+			}
+			g[mOrder[k]] += g1;
+			g[mOrder[k2]] += g2;
+		}
+	}
+};
+
+static void vbap_(Thread& th, Prim* prim)
+{
+	P<List> speakers = th.popList("vbap : speakers");
+	std::vector<ZIn> azimuths = popChannels(th, "vbap : azimuths");
+	std::vector<ZIn> sources = popChannels(th, "vbap : sources");
+
+	if (!speakers->isFinite())
+		indefiniteOp("vbap : speakers", "");
+	speakers = speakers->packz(th);
+	if (speakers->length(th) == 0) {
+		post("vbap : no speakers\n");
+		throw errFailed;
+	}
+
+	if (azimuths.size() == 1) {
+		azimuths.resize(sources.size(), azimuths[0]);
+	} else if (azimuths.size() != sources.size()) {
+		post("vbap : %d azimuths for %d sources\n", (int)azimuths.size(), (int)sources.size());
+		throw errFailed;
+	}
+
+	P<VBAP> pan = new VBAP(th, sources, azimuths, speakers->mArray());
+	th.push(pan->createOutputs(th));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// third order ambisonics in ACN channel order with SN3D normalization.
+// directions are in the units of rot2: azimuth 0 is front, +.5 is 90 degrees left, elevation +.5 is straight up.
+// x is front, y is left, z is up.
+
+const int kHOAOrder = 3;
+const int kHOAChannels = (kHOAOrder + 1) * (kHOAOrder + 1);
+
+static void hoaDirection(Z az, Z el, Z& x, Z& y, Z& z)
+{
+	az *= M_PI;
+	el *= M_PI;
+	x = cos(el) * cos(az);
+	y = cos(el) * sin(az);
+	z = sin(el);
+}
+
+// spherical harmonics up to third order for a unit vector.
+static void hoaSN3D(Z x, Z y, Z z, Z* Y)
+{
+	const Z s3 = sqrt(3.);
+	const Z s15 = sqrt(15.);
+	const Z s38 = sqrt(3./8.);
+	const Z s58 = sqrt(5./8.);
+	Z x2 = x*x, y2 = y*y, z2 = z*z;
+	Y[0] = 1.;
+	Y[1] = y;
+	Y[2] = z;
+	Y[3] = x;
+	Y[4] = s3 * x * y;
+	Y[5] = s3 * y * z;
+	Y[6] = .5 * (3. * z2 - 1.);
+	Y[7] = s3 * x * z;
+	Y[8] = .5 * s3 * (x2 - y2);
+	Y[9] = s58 * y * (3. * x2 - y2);
+	Y[10] = s15 * x * y * z;
+	Y[11] = s38 * y * (5. * z2 - 1.);
+	Y[12] = .5 * z * (5. * z2 - 3.);
+	Y[13] = s38 * x * (5. * z2 - 1.);
+	Y[14] = .5 * s15 * z * (x2 - y2);
+	Y[15] = s58 * x * (x2 - 3. * y2);
+}
+
+static int hoaOrderOf(int channel)
+{
+	return channel == 0 ? 0 : channel < 4 ? 1 : channel < 9 ? 2 : 3;
+}
+
+static int hoaOrderForChannels(const char* msg, size_t numChannels)
+{
+	for (int order = 1; order <= kHOAOrder; ++order) {
+		if (numChannels == (size_t)((order + 1) * (order + 1))) return order;
+	}
+	post("%s : %d channels is not a first, second or third order ambisonic signal.\n", msg, (int)numChannels);
+	throw errFailed;
+}
+
+// A quadrature on the sphere that is exact for polynomials up to degree 7, so it integrates products of two
+// third order harmonics exactly. 4 Gauss-Legendre rings of 8 points. Used to build rotation matrices.
+struct HOAQuadrature
+{
+	static const int kRings = 4;
+	static const int kPointsPerRing = 8;
+	static const int kNumPoints = kRings * kPointsPerRing;
+
+	Z x[kNumPoints], y[kNumPoints], z[kNumPoints];
+	Z weight[kNumPoints]; // normalized to sum to one
+	Z Y[kNumPoints][kHOAChannels]; // N3D, which is orthonormal over the sphere.
+	
+	HOAQuadrature()
+	{
+		const Z nodes[kRings] = { -0.8611363115940526, -0.3399810435848563, 0.3399810435848563, 0.8611363115940526 };
+		const Z weights[kRings] = { 0.3478548451374538, 0.6521451548625461, 0.6521451548625461, 0.3478548451374538 };
+		int k = 0;
+		for (int r = 0; r < kRings; ++r) {
+			Z zr = nodes[r];
+			Z rho = sqrt(1. - zr * zr);
+			for (int p = 0; p < kPointsPerRing; ++p, ++k) {
+				Z phi = 2. * M_PI * p / kPointsPerRing;
+				x[k] = rho * cos(phi);
+				y[k] = rho * sin(phi);
+				z[k] = zr;
+				weight[k] = .5 * weights[r] / kPointsPerRing;
+				hoaSN3D(x[k], y[k], z[k], Y[k]);
+				for (int i = 0; i < kHOAChannels; ++i) Y[k][i] *= sqrt(2. * hoaOrderOf(i) + 1.);
+			}
+		}
+	}
+};
+
+static const HOAQuadrature& hoaQuadrature()
+{
+	static HOAQuadrature sQuadrature;
+	return sQuadrature;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct HOAEncode : public MatrixMix
+{
+	HOAEncode(Thread& th, std::vector<ZIn> const& inSources, std::vector<ZIn> const& inDirections)
+		: MatrixMix(th, inSources, inDirections, kHOAChannels)
+	{
+	}
+	
+	virtual const char* TypeName() const override { return "HOAEncode"; }
+
+	// controls are all the azimuths followed by all the elevations.
+	virtual void calcGains(Z* outGains) override
+	{
+		int N = numIns();
+		for (int i = 0; i < N; ++i) {
+			Z x, y, z;
+			hoaDirection(mControlValues[i], mControlValues[N + i], x, y, z);
+			hoaSN3D(x, y, z, outGains + i * kHOAChannels);
 		}
+	}
+};
+
+// rotates the sound field by yaw, pitch and roll, about the z, y and x axes in that order.
+// the rotation matrix is block diagonal, one block per order, so the mixer skips the zeros between blocks.
+struct HOARotate : public MatrixMix
+{
+	HOARotate(Thread& th, std::vector<ZIn> const& inChannels, std::vector<ZIn> const& inAngles)
+		: MatrixMix(th, inChannels, inAngles, (int)inChannels.size())
+	{
+	}
+	
+	virtual const char* TypeName() const override { return "HOARotate"; }
+
+	virtual void calcGains(Z* outGains) override
+	{
+		Z cy = cos(M_PI * mControlValues[0]), sy = sin(M_PI * mControlValues[0]);
+		Z cp = cos(M_PI * mControlValues[1]), sp = sin(M_PI * mControlValues[1]);
+		Z cr = cos(M_PI * mControlValues[2]), sr = sin(M_PI * mControlValues[2]);
+		Z R[3][3] = {
+			{ cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr },
+			{ sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr },
+			{ -sp,     cp * sr,                cp * cr }
+		};
 		
-		_prev = prev;
-		produce(framesToFill);
+		// D[j][i] = sum over the sphere of Y_j(R p) Y_i(p). D maps the encoding of a direction to the encoding of the rotated direction.
+		int C = numIns();
+		std::fill(outGains, outGains + C * C, 0.);
+		const HOAQuadrature& q = hoaQuadrature();
+		Z Yr[kHOAChannels];
+		for (int k = 0; k < HOAQuadrature::kNumPoints; ++k) {
+			Z x = R[0][0] * q.x[k] + R[0][1] * q.y[k] + R[0][2] * q.z[k];
+			Z y = R[1][0] * q.x[k] + R[1][1] * q.y[k] + R[1][2] * q.z[k];
+			Z z = R[2][0] * q.x[k] + R[2][1] * q.y[k] + R[2][2] * q.z[k];
+			hoaSN3D(x, y, z, Yr);
+			Z w = q.weight[k];
+			for (int l = 0, start = 0; start < C; start += 2 * l + 1, ++l) {
+				Z wl = w * sqrt(2. * l + 1.);
+				int end = start + 2 * l + 1;
+				for (int j = start; j < end; ++j) {
+					Z wy = wl * Yr[j];
+					for (int i = start; i < end; ++i) {
+						outGains[i * C + j] += wy * q.Y[k][i];
+					}
+				}
+			}
+		}
+	}
+};
+
+// sampling decoder. each speaker output is the sound field sampled in the speaker's direction.
+struct HOADecode : public MatrixMix
+{
+	std::vector<Z> mSpeakerGains;
+	
+	HOADecode(Thread& th, std::vector<ZIn> const& inChannels, Array* inAzimuths, Array* inElevations)
+		: MatrixMix(th, inChannels, std::vector<ZIn>(), (int)inAzimuths->size())
+	{
+		int C = numIns();
+		int M = numOuts();
+		mSpeakerGains.resize(C * M);
+		Z Y[kHOAChannels];
+		for (int j = 0; j < M; ++j) {
+			Z x, y, z;
+			hoaDirection(inAzimuths->atz(j), inElevations->atz(j), x, y, z);
+			hoaSN3D(x, y, z, Y);
+			for (int i = 0; i < C; ++i) {
+				mSpeakerGains[i * M + j] = (2. * hoaOrderOf(i) + 1.) * Y[i] / M;
+			}
+		}
+	}
+	
+	virtual const char* TypeName() const override { return "HOADecode"; }
+
+	virtual void calcGains(Z* outGains) override
+	{
+		std::copy(mSpeakerGains.begin(), mSpeakerGains.end(), outGains);
 	}
+};
+
+static void hoaenc_(Thread& th, Prim* prim)
+{
+	std::vector<ZIn> elevations = popChannels(th, "hoaenc : elevations");
+	std::vector<ZIn> azimuths = popChannels(th, "hoaenc : azimuths");
+	std::vector<ZIn> sources = popChannels(th, "hoaenc : sources");
+
+	size_t N = sources.size();
+	if (azimuths.size() == 1) azimuths.resize(N, azimuths[0]);
+	if (elevations.size() == 1) elevations.resize(N, elevations[0]);
+	if (azimuths.size() != N || elevations.size() != N) {
+		post("hoaenc : %d azimuths and %d elevations for %d sources\n", (int)azimuths.size(), (int)elevations.size(), (int)N);
+		throw errFailed;
+	}
+	
+	std::vector<ZIn> directions = azimuths;
+	directions.insert(directions.end(), elevations.begin(), elevations.end());
+
+	P<HOAEncode> enc = new HOAEncode(th, sources, directions);
+	th.push(enc->createOutputs(th));
+}
+
+static void hoarot_(Thread& th, Prim* prim)
+{
+	V roll = th.popZIn("hoarot : roll");
+	V pitch = th.popZIn("hoarot : pitch");
+	V yaw = th.popZIn("hoarot : yaw");
+	std::vector<ZIn> channels = popChannels(th, "hoarot : channels");
+	hoaOrderForChannels("hoarot", channels.size());
+
+	std::vector<ZIn> angles = { ZIn(yaw), ZIn(pitch), ZIn(roll) };
+	
+	P<HOARotate> rot = new HOARotate(th, channels, angles);
+	th.push(rot->createOutputs(th));
+}
+
+static void hoadec_(Thread& th, Prim* prim)
+{
+	P<List> elevations = th.popList("hoadec : elevations");
+	P<List> azimuths = th.popList("hoadec : azimuths");
+	std::vector<ZIn> channels = popChannels(th, "hoadec : channels");
+	hoaOrderForChannels("hoadec", channels.size());
+
+	if (!azimuths->isFinite())
+		indefiniteOp("hoadec : azimuths", "");
+	if (!elevations->isFinite())
+		indefiniteOp("hoadec : elevations", "");
+	azimuths = azimuths->packz(th);
+	elevations = elevations->packz(th);
 	
+	if (azimuths->length(th) == 0 || azimuths->length(th) != elevations->length(th)) {
+		post("hoadec : azimuths and elevations must be non empty lists of the same length.\n");
+		throw errFailed;
+	}
+
+	P<HOADecode> dec = new HOADecode(th, channels, azimuths->mArray(), elevations->mArray());
+	th.push(dec->createOutputs(th));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+	kTrigLevel,		// above zero
+	kTrigRising,	// above zero after being at or below it
+	kTrigFromNeg	// at or above zero after being below it
 };
 
-struct NegTrig : public Gen
+// the vector part of triggerMask for a unit stride input. it sets the bits for the samples it
+// covers, leaves the last of them in prev and returns how many it covered.
+#if defined(__aarch64__)
+#define TRIGGER_MASK_SIMD 1
+template <int Kind>
+static int triggerMaskSIMD(int n, Z const* in, Z& prev, uint64_t& mask)
+{
+	float64x2_t zero = vdupq_n_f64(0.);
+	float64x2_t last = vdupq_n_f64(prev);
+	int i = 0;
+	for (; i + 2 <= n; i += 2) {
+		float64x2_t cur = vld1q_f64(in + i);
+		uint64x2_t hit = Kind == kTrigFromNeg ? vcgeq_f64(cur, zero) : vcgtq_f64(cur, zero);
+		if (Kind != kTrigLevel) {
+			float64x2_t before = vextq_f64(last, cur, 1);
+			hit = vandq_u64(hit, Kind == kTrigFromNeg ? vcltq_f64(before, zero) : vcleq_f64(before, zero));
+		}
+		// narrow the all ones or all zeros lanes to one bit each.
+		uint32x2_t bits = vmovn_u64(vshrq_n_u64(hit, 63));
+		mask |= (uint64_t)(vget_lane_u32(bits, 0) | vget_lane_u32(bits, 1) << 1) << i;
+		last = cur;
+	}
+	if (i) prev = in[i - 1];
+	return i;
+}
+#elif defined(__x86_64__) && defined(__GNUC__)
+#define TRIGGER_MASK_SIMD 1
+template <int Kind>
+__attribute__((target("avx2")))
+static int triggerMaskAVX2(int n, Z const* in, Z& prev, uint64_t& mask)
+{
+	__m256d zero = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d cur = _mm256_loadu_pd(in + i);
+		__m256d hit = Kind == kTrigFromNeg ? _mm256_cmp_pd(cur, zero, _CMP_GE_OQ) : _mm256_cmp_pd(cur, zero, _CMP_GT_OQ);
+		if (Kind != kTrigLevel) {
+			__m256d before = i ? _mm256_loadu_pd(in + i - 1) : _mm256_set_pd(in[2], in[1], in[0], prev);
+			hit = _mm256_and_pd(hit, Kind == kTrigFromNeg ? _mm256_cmp_pd(before, zero, _CMP_LT_OQ) : _mm256_cmp_pd(before, zero, _CMP_LE_OQ));
+		}
+		mask |= (uint64_t)_mm256_movemask_pd(hit) << i;
+	}
+	if (i) prev = in[i - 1];
+	return i;
+}
+
+// x86_64 builds may not assume AVX2, so it is checked for the first time a mask is made.
+static bool haveAVX2()
+{
+#if defined(__AVX2__)
+	return true;
+#else
+	static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+	return avx2;
+#endif
+}
+
+template <int Kind>
+static int triggerMaskSIMD(int n, Z const* in, Z& prev, uint64_t& mask)
+{
+	return haveAVX2() ? triggerMaskAVX2<Kind>(n, in, prev, mask) : 0;
+}
+#endif
+
+// returns a bit for each of n <= 64 samples of a trigger input that fires, so that sparse
+// triggers cost a few vector compares per block and per event work runs only where a bit is set.
+template <int Kind>
+static uint64_t triggerMask(int n, Z const* in, int stride, Z prev)
+{
+	uint64_t mask = 0;
+	int i = 0;
+#if TRIGGER_MASK_SIMD
+	if (stride == 1) i = triggerMaskSIMD<Kind>(n, in, prev, mask);
+#endif
+	for (; i < n; ++i) {
+		Z cur = in[i * stride];
+		bool hit = Kind == kTrigLevel ? cur > 0.
+				 : Kind == kTrigRising ? cur > 0. && prev <= 0.
+				 : cur >= 0. && prev < 0.;
+		mask |= (uint64_t)hit << i;
+		prev = cur;
+	}
+	return mask;
+}
+
+const int kTrigChunk = 64;
+
+template <int Kind>
+struct EdgeTrig : public Gen
 {
 	ZIn _in;
 	Z _prev;
 	
-	NegTrig(Thread& th, Arg in)
-		: Gen(th, itemTypeZ, in.isFinite()), _in(in), _prev(-1.)
+	EdgeTrig(Thread& th, Arg in, Z prev)
+		: Gen(th, itemTypeZ, in.isFinite()), _in(in), _prev(prev)
 	{
 	}
 	
-	virtual const char* TypeName() const override { return "NegTrig"; }
-	
 	virtual void pull(Thread& th) override
 	{
 		int framesToFill = mBlockSize;
@@ -3813,12 +4873,15 @@ struct NegTrig : public Gen
 				break;
 			}
 			
-			for (int i = 0; i < n; ++i) {
-				
-				Z cur = *in;
-				out[i] = cur >= 0. && prev < 0. ? 1. : 0.;
-				prev = cur;
-				in += inStride;
+			memset(out, 0, n * sizeof(Z));
+			for (int i = 0; i < n; i += kTrigChunk) {
+				int m = std::min(kTrigChunk, n - i);
+				Z* chunk = in + i * inStride;
+				uint64_t mask = triggerMask<Kind>(m, chunk, inStride, prev);
+				for (; mask; mask &= mask - 1) {
+					out[i + __builtin_ctzll(mask)] = 1.;
+				}
+				prev = chunk[(m - 1) * inStride];
 			}
 			
 			framesToFill -= n;
@@ -3832,6 +4895,20 @@ struct NegTrig : public Gen
 	
 };
 
+struct Trig : public EdgeTrig<kTrigRising>
+{
+	Trig(Thread& th, Arg in) : EdgeTrig<kTrigRising>(th, in, 0.) {}
+	
+	virtual const char* TypeName() const override { return "Trig"; }
+};
+
+struct NegTrig : public EdgeTrig<kTrigFromNeg>
+{
+	NegTrig(Thread& th, Arg in) : EdgeTrig<kTrigFromNeg>(th, in, -1.) {}
+	
+	virtual const char* TypeName() const override { return "NegTrig"; }
+};
+
 static void tr_(Thread& th, Prim* prim)
 {
 	V in   = th.popZIn("tr : in");
@@ -3861,15 +4938,38 @@ struct Gate : public TwoInputUGen<Gate>
 	
 	void calc(int n, Z* out, Z* trig, Z* hold, int trigStride, int holdStride) 
 	{
-		for (int i = 0; i < n; ++i) {
-			Z t = *trig;
-			if (t > 0.) {
+		for (int i = 0; i < n; i += kTrigChunk) {
+			int m = std::min(kTrigChunk, n - i);
+			uint64_t mask = triggerMask<kTrigLevel>(m, trig + i * trigStride, trigStride, 0.);
+			Z* o = out + i;
+			Z* h = hold + i * holdStride;
+			int j = 0;
+			while (true) {
+				int next = mask ? __builtin_ctzll(mask) : m;
+				if (holdStride == 0) {
+					// open until phase reaches hold, then closed until the next trigger.
+					Z hv = *h;
+					for (; j < next && phase < hv; ++j) {
+						o[j] = 1.;
+						phase += freq;
+					}
+					int k = next - j;
+					memset(o + j, 0, k * sizeof(Z));
+					phase += k * freq;
+					j = next;
+				} else {
+					for (; j < next; ++j) {
+						o[j] = phase < h[j * holdStride] ? 1. : 0.;
+						phase += freq;
+					}
+				}
+				if (!mask) break;
+				mask &= mask - 1;
 				phase = 0.;
+				o[j] = phase < h[j * holdStride] ? 1. : 0.;
+				phase += freq;
+				++j;
 			}
-			out[i] = phase < *hold ? 1. : 0.;
-			phase += freq;
-			trig += trigStride;
-			hold += holdStride;
 		}
 	}
 };
@@ -3912,11 +5012,17 @@ struct SampleAndHold : public Gen
 				break;
 			}
 			
-			for (int i = 0; i < n; ++i) {				
-				if (*tr > 0.) val = *in;
-				out[i] = val;
-				in += inStride;
-				tr += trStride;
+			for (int i = 0; i < n; i += kTrigChunk) {
+				int m = std::min(kTrigChunk, n - i);
+				uint64_t mask = triggerMask<kTrigLevel>(m, tr + i * trStride, trStride, 0.);
+				int j = 0;
+				for (; mask; mask &= mask - 1) {
+					int k = __builtin_ctzll(mask);
+					vDSP_vfillD(&val, out + i + j, 1, k - j);
+					val = in[(i + k) * inStride];
+					j = k;
+				}
+				vDSP_vfillD(&val, out + i + j, 1, m - j);
 			}
 			
 			framesToFill -= n;
@@ -3971,18 +5077,21 @@ struct Sequencer : public Gen
 				break;
 			}
 			
-			for (int i = 0; i < n; ++i) {				
-				if (*tr > 0.) {
-					Z z;
-					if (_in.onez(th, z)) {
+			for (int i = 0; i < n; i += kTrigChunk) {
+				int m = std::min(kTrigChunk, n - i);
+				uint64_t mask = triggerMask<kTrigLevel>(m, tr + i * trStride, trStride, 0.);
+				int j = 0;
+				for (; mask; mask &= mask - 1) {
+					int k = __builtin_ctzll(mask);
+					vDSP_vfillD(&val, out + i + j, 1, k - j);
+					if (_in.onez(th, val)) {
 						setDone();
-						produce(framesToFill - i);
+						produce(framesToFill - (i + k));
 						return;
 					}
-					val = z;
+					j = k;
 				}
-				out[i] = val;
-				tr += trStride;
+				vDSP_vfillD(&val, out + i + j, 1, m - j);
 			}
 			
 			framesToFill -= n;
@@ -4035,19 +5144,18 @@ struct ImpulseSequencer : public Gen
 				break;
 			}
 			
-			for (int i = 0; i < n; ++i) {				
-				if (*tr > 0.) {
-					Z z;
-					if (_in.onez(th, z)) {
+			memset(out, 0, n * sizeof(Z));
+			for (int i = 0; i < n; i += kTrigChunk) {
+				int m = std::min(kTrigChunk, n - i);
+				uint64_t mask = triggerMask<kTrigLevel>(m, tr + i * trStride, trStride, 0.);
+				for (; mask; mask &= mask - 1) {
+					int k = i + __builtin_ctzll(mask);
+					if (_in.onez(th, out[k])) {
 						setDone();
-						produce(framesToFill - i);
+						produce(framesToFill - k);
 						return;
 					}
-					out[i] = z;
-				} else {
-					out[i] = 0.;
 				}
-				tr += trStride;
 			}
 			
 			framesToFill -= n;
@@ -4098,17 +5206,19 @@ struct PulseDivider : public Gen
 				break;
 			}
 			
-			for (int i = 0; i < n; ++i) {				
-				if (*tr > 0.) {
+			memset(out, 0, n * sizeof(Z));
+			for (int i = 0; i < n; i += kTrigChunk) {
+				int m = std::min(kTrigChunk, n - i);
+				uint64_t mask = triggerMask<kTrigLevel>(m, tr + i * trStride, trStride, 0.);
+				for (; mask; mask &= mask - 1) {
+					int k = i + __builtin_ctzll(mask);
 					_count += 1.;
-					Z idiv = floor(*div + .5);
+					Z idiv = floor(div[k * divStride] + .5);
 					if (_count >= idiv) {
 						_count -= idiv;
 					}
-					out[i] = _count == 0. ? *tr : 0.;
-				} else out[i] = 0.;
-				tr += trStride;
-				div += divStride;
+					if (_count == 0.) out[k] = tr[k * trStride];
+				}
 			}
 			
 			framesToFill -= n;
@@ -4558,6 +5668,8 @@ void AddUGenOps()
 	gK2AC = automap("zk", 2, new Prim(k2ac_, V(0.), 2, 1, "", ""), "", "");
 	DEF(kr, 2, "(fun n --> out) evaluates fun with the current sample rate divided by n, then linearly upsamples all returned signals by n.")
 	DEF(krc, 2, "(fun n --> out) evaluates fun with the current sample rate divided by n, then cubically upsamples all returned signals by n.")
+	gDownsample = automap("zk", 2, new Prim(downsample_, V(0.), 2, 1, "", ""), "", "");
+	DEF(oversample, 3, "(in fun factor --> out) upsamples in by factor (2, 4 or 8), applies fun to it at factor times the current sample rate, then downsamples all returned signals. Only fun pays for the higher rate, e.g. to reduce aliasing from waveshaping. in may be a list of signals, which are passed to fun as separate arguments. Other signals that fun uses run at the higher rate too, so pass them in through in. The half band filters are linear phase and add a delay of 23, 34.5 or 40.25 samples for a factor of 2, 4 or 8.")
 	
 	vm.addBifHelp("\n*** control function unit generators ***");
 	DEFAM(imps, aaz, "(values durs rate --> out) single sample impulses.");
@@ -4638,6 +5750,12 @@ void AddUGenOps()
 	DEFMCX(rot2, 3, "(left right pos --> [left right]) stereo rotation. pos 0 is no rotation, +/-1 is 180 degrees, -.5 is -90 degrees, +.5 is +90 degrees.")
 	DEFMCX(bal2, 3, "(left right pos --> [left right]) stereo balance control. pos 0 is center. pos -1 is full left, pos +1 is full right.")
 	DEFMCX(fade2, 3, "(left right pos --> out) cross fade between two inputs. pos 0 is equal mix. pos -1 is all left, pos +1 is all right.")
+	DEF(vbap, 3, "(sources azimuths speakers --> [out1 ... outM]) pan a list of sources to a ring of speakers by vector base amplitude panning. azimuths and speakers are in the units of rot2: 0 is front, +/-1 is 180 degrees, +.5 is +90 degrees. a single azimuth applies to all sources. azimuths are read every 32 samples and gains are interpolated in between.")
+
+	vm.addBifHelp("\n*** ambisonic unit generators ***");
+	DEF(hoaenc, 3, "(sources azimuths elevations --> [16 channels]) encode a list of sources to third order ambisonics, ACN channel order, SN3D normalization. angles are in the units of rot2: azimuth 0 is front, +.5 is 90 degrees left, elevation +.5 is straight up. directions are read every 32 samples and gains are interpolated in between.")
+	DEF(hoarot, 4, "(channels yaw pitch roll --> channels) rotate a first, second or third order ambisonic sound field about the z, y and x axes. angles are in the units of rot2 and are read every 32 samples.")
+	DEF(hoadec, 3, "(channels azimuths elevations --> [out1 ... outM]) decode a first, second or third order ambisonic sound field to speakers at the given directions with a sampling decoder.")
 
 	
 	vm.addBifHelp("\n*** trigger unit generators ***");
@@ -18,6 +18,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <cmath>
+#include <map>
+#include <vector>
 
 
 FFTSetupD fftSetups[kMaxFFTLogSize+1];
@@ -156,3 +158,176 @@ inline void complex_expD_conj(double& re, double& im)
 	im = rho * sinf(im);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double bessi0(double x)
+{
+	//returns the modified Bessel function I_0(x) for any real x
+	//from numerical recipes
+	
+	double ax, ans;
+	double y;
+	
+	if((ax=fabs(x))<3.75){
+		y=x/3.75;
+		y *= y;
+		ans =1.0+y*(3.5156229+y*(3.0899424+y*(1.2067492
+			+y*(0.2659732+y*(0.360768e-1+y*0.45813e-2)))));
+	}
+	else{
+		y=3.75/ax;
+		ans = (exp(ax)/sqrt(ax))*(0.39894228+y*(0.1328592e-1
+			+y*(0.225319e-2+y*(-0.157565e-2+y*(0.916281e-2
+			+y*(-0.2057706e-1+y*(0.2635537e-1+y*(-0.1647633e-1
+			+y*0.392377e-2))))))));
+	}
+
+	return ans;
+}
+
+static double kaiser_alpha(double atten)
+{
+	double alpha = 0.;
+	if (atten > 50.) 
+		alpha = .1102 * (atten - 8.7);
+	else if (atten >= 21.)
+		alpha = .5842 * pow(atten - 21., .4) + .07886 * (atten - 21.);
+	return alpha;
+}
+
+static void kaiser(size_t m, double *s, double alpha)
+{
+	if (m == 0) return;
+	if (m == 1) {
+		s[0] = 1.;
+		return;
+	}
+	size_t n = m-1;
+	double p = n / 2.;
+	double rp = 1. / p;
+	double rb = 1. / bessi0(alpha);
+	
+	for (size_t i = 0; i < m; ++i) {
+		double x = (i-p) * rp;
+		s[i] = rb * bessi0(alpha * sqrt(1. - x*x));
+	}
+}
+
+// adds amp * cos(k * x) to out.
+static void addCosine(int64_t n, const double* x, double k, double amp, double* tmp, double* out)
+{
+	int len = (int)n;
+	vDSP_vsmulD(x, 1, &k, tmp, 1, n);
+	vvcos(tmp, tmp, &len);
+	vDSP_vsmaD(tmp, 1, &amp, out, 1, out, 1, n);
+}
+
+static void fillWindow(int type, int64_t n, double param, double* w)
+{
+	if (n == 1 && type >= kWindowBlackmanHarris) {
+		w[0] = 1.;
+		return;
+	}
+	switch (type) {
+		case kWindowHann :
+			vDSP_hann_windowD(w, n, 0);
+			break;
+		case kWindowHamming :
+			vDSP_hamm_windowD(w, n, 0);
+			break;
+		case kWindowBlackman :
+			vDSP_blkman_windowD(w, n, 0);
+			break;
+		case kWindowBlackmanHarris : {
+			// periodic, like the vDSP windows above.
+			std::vector<double> x(n), tmp(n);
+			double start = 0.;
+			double step = 2. * M_PI / n;
+			vDSP_vrampD(&start, &step, x.data(), 1, n);
+			double a0 = .35875;
+			vDSP_vfillD(&a0, w, 1, n);
+			addCosine(n, x.data(), 1., -.48829, tmp.data(), w);
+			addCosine(n, x.data(), 2., .14128, tmp.data(), w);
+			addCosine(n, x.data(), 3., -.01168, tmp.data(), w);
+			break;
+		}
+		case kWindowKaiser :
+			kaiser(n, w, kaiser_alpha(param));
+			break;
+		case kWindowGaussian : {
+			// exp(-.5 * (x / sigma)^2) for x from -1 to 1.
+			double halfWidth = .5 * (n - 1);
+			double step = 1. / (param * halfWidth);
+			double start = -halfWidth * step;
+			double scale = -.5;
+			int len = (int)n;
+			vDSP_vrampD(&start, &step, w, 1, n);
+			vDSP_vsqD(w, 1, w, 1, n);
+			vDSP_vsmulD(w, 1, &scale, w, 1, n);
+			vvexp(w, w, &len);
+			break;
+		}
+		case kWindowTukey : {
+			// flat in the middle with half cosine tapers at each end.
+			double one = 1.;
+			vDSP_vfillD(&one, w, 1, n);
+			double taperWidth = param * (n - 1);
+			int64_t m = std::min((int64_t)ceil(.5 * taperWidth), n);
+			if (m > 0) {
+				double start = -M_PI;
+				double step = 2. * M_PI / taperWidth;
+				double half = .5;
+				int len = (int)m;
+				vDSP_vrampD(&start, &step, w, 1, m);
+				vvcos(w, w, &len);
+				vDSP_vsmsaD(w, 1, &half, &half, w, 1, m);
+				for (int64_t i = 0; i < m; ++i) w[n-1-i] = std::min(w[n-1-i], w[i]);
+			}
+			break;
+		}
+	}
+}
+
+static P<Array> makeWindow(int type, int64_t n, double param)
+{
+	P<Array> window = new Array(itemTypeZ, n);
+	window->setSize(n);
+	fillWindow(type, n, param, window->z());
+	return window;
+}
+
+struct WindowKey
+{
+	int type;
+	int64_t n;
+	double param;
+	
+	bool operator<(WindowKey const& that) const
+	{
+		if (type != that.type) return type < that.type;
+		if (n != that.n) return n < that.n;
+		return param < that.param;
+	}
+};
+
+static std::map<WindowKey, P<Array>> gWindows;
+static os_unfair_lock gWindowLock = OS_UNFAIR_LOCK_INIT;
+
+P<Array> getWindow(int type, int64_t n, double param)
+{
+	if (n > kMaxCachedWindowSize) return makeWindow(type, n, param);
+	
+	WindowKey key = { type, n, param };
+	{
+		SpinLocker lock(gWindowLock);
+		auto it = gWindows.find(key);
+		if (it != gWindows.end()) return it->second;
+	}
+
+	// computed outside the lock. if another thread makes the same window meanwhile, theirs is kept.
+	P<Array> window = makeWindow(type, n, param);
+	
+	SpinLocker lock(gWindowLock);
+	if (gWindows.size() >= kMaxCachedWindows) gWindows.clear();
+	return gWindows.emplace(key, window).first->second;
+}
@@ -16,7 +16,11 @@
 
 #include "primes.hpp"
 #include "ErrorCodes.hpp"
+#include "clz.hpp"
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
 
 // Within a cycle of 30, there are only 8 numbers that are not multiples of 2, 3 or 5.
 // We pack these 8 into a one byte bit map.
@@ -2120,33 +2124,52 @@ uint8_t gPrimesMask[kPrimesMaskSize] = {
 	0x08, 0x12, 0xc1, 0x61, 0x08, 0x38 
 };
 
+// deterministic Miller-Rabin. these bases are enough for every n below 2^64.
 
-static bool isprime_slow(int64_t x)
+static const uint64_t gMillerRabinBases[12] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+
+static inline uint64_t mulmod(uint64_t a, uint64_t b, uint64_t m)
+{
+	return (uint64_t)((unsigned __int128)a * b % m);
+}
+
+static uint64_t powmod(uint64_t a, uint64_t e, uint64_t m)
+{
+	uint64_t r = 1;
+	while (e) {
+		if (e & 1) r = mulmod(r, a, m);
+		a = mulmod(a, a, m);
+		e >>= 1;
+	}
+	return r;
+}
+
+static bool isprime_millerRabin(uint64_t n)
 {
-	for (int i = 3; i < 10; ++i) {
-		if (x % gLowPrimes[i] == 0)
-			return false;
+	// caller has already removed n < 31 and multiples of 2, 3 and 5.
+	uint64_t d = n - 1;
+	int s = 0;
+	while (!(d & 1)) {
+		d >>= 1;
+		++s;
 	}
 	
-	for (int i = 0; i < kPrimesMaskSize; ++i) {
-		if (gPrimesMask[i] == 0) continue;
-		int64_t k = 30 * (i+1);
-		for (int j = 0; j < 8; ++j) {
-			if (!(gPrimesMask[k] & (1 << j))) continue;
-			int64_t m = k + gPrimeOffsets[j];
-			if (m*m > x) {
-				return true;
+	for (int i = 0; i < 12; ++i) {
+		uint64_t x = powmod(gMillerRabinBases[i], d, n);
+		if (x == 1 || x == n - 1) continue;
+		bool composite = true;
+		for (int r = 1; r < s; ++r) {
+			x = mulmod(x, x, n);
+			if (x == n - 1) {
+				composite = false;
+				break;
 			}
-			
-			if (x % m == 0) return false;
 		}
+		if (composite) return false;
 	}
-	
-	throw errOutOfRange;
+	return true;
 }
 
-#include <stdio.h>
-
 bool isprime(int64_t x)
 {
 	if (x <= 30) {
@@ -2159,21 +2182,105 @@ bool isprime(int64_t x)
 	if (shift < 0) return false; // eliminate multiples of 2,3,5.
 	int64_t byte = x / 30 - 1;
 		
-	if (byte >= kPrimesMaskSize) return isprime_slow(x);	
+	if (byte >= kPrimesMaskSize) return isprime_millerRabin(x);	
 	
 	return gPrimesMask[byte] & (1 << shift);
 }
 
-
 int64_t nextPrime(int64_t x)
 {
+	if (x <= 2) return 2;
 	for (;; ++x) {
 		if (isprime(x)) return x;
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+
+// the sieving primes are 7 and up, taken from gPrimesMask, each with the inverse of 30 mod p.
+// they cover every composite below kPrimeSieveLimit.
 
+struct SievingPrime
+{
+	int p;
+	int inv30;
+};
 
+static std::vector<SievingPrime> const& sievingPrimes()
+{
+	static std::vector<SievingPrime> primes = []() {
+		std::vector<SievingPrime> v;
+		auto add = [&](int p) { v.push_back({ p, (int)powmod(30 % p, p - 2, p) }); };
+		for (int i = 3; i < 10; ++i) add(gLowPrimes[i]);
+		for (int byte = 0; byte < kPrimesMaskSize; ++byte) {
+			for (int bit = 0; bit < 8; ++bit) {
+				if (gPrimesMask[byte] & (1 << bit)) add(30 * (byte + 1) + gPrimeOffsets[bit]);
+			}
+		}
+		return v;
+	}();
+	return primes;
+}
 
+PrimeSieve::PrimeSieve()
+	: mSegByte(0), mByte(kPrimeSieveSegmentSize), mBits(0), mLow(0)
+{
+	sievingPrimes();
+}
 
+void PrimeSieve::sieveSegment()
+{
+	// byte b of the wheel holds 30b + gPrimeOffsets[bit]. byte 0 is covered by gLowPrimes, so start at byte 1.
+	mSegByte = mSegByte ? mSegByte + kPrimeSieveSegmentSize : 1;
+	int64_t segEnd = mSegByte + kPrimeSieveSegmentSize;
+	int64_t hi = 30 * segEnd;
+	
+	memset(mSeg, 0xff, kPrimeSieveSegmentSize);
+	for (SievingPrime const& sp : sievingPrimes()) {
+		int64_t p = sp.p;
+		if (p * p >= hi) break;
+		for (int bit = 0; bit < 8; ++bit) {
+			int64_t o = gPrimeOffsets[bit];
+			// the bytes whose number in this column is a multiple of p are b = -o / 30 mod p.
+			int64_t b0 = (p - (o * sp.inv30) % p) % p;
+			// never strike p itself or anything below p*p.
+			int64_t start = std::max(mSegByte, (p * p - o + 29) / 30);
+			int64_t b = start + ((b0 - start) % p + p) % p;
+			uint8_t mask = ~(1 << bit);
+			for (; b < segEnd; b += p) {
+				mSeg[b - mSegByte] &= mask;
+			}
+		}
+	}
+	mByte = 0;
+	mBits = mSeg[0];
+}
 
+int PrimeSieve::next(int n, int64_t* out)
+{
+	int i = 0;
+	for (; i < n && mLow < 10; ++i) {
+		out[i] = gLowPrimes[mLow++];
+	}
+	while (i < n) {
+		if (mBits) {
+			int bit = CTZ((int32_t)mBits);
+			mBits &= mBits - 1;
+			int64_t x = 30 * (mSegByte + mByte) + gPrimeOffsets[bit];
+			if (x >= kPrimeSieveLimit) {
+				mBits = 0;
+				mByte = kPrimeSieveSegmentSize;
+				mSegByte = kPrimeSieveLimit;
+				break;
+			}
+			out[i++] = x;
+		} else if (++mByte < kPrimeSieveSegmentSize) {
+			mBits = mSeg[mByte];
+		} else if (30 * (mSegByte + kPrimeSieveSegmentSize) < kPrimeSieveLimit) {
+			sieveSegment();
+		} else {
+			break;
+		}
+	}
+	return i;
+}
@@ -18,60 +18,56 @@
 #define _Hash_
 
 #include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
 
 
-// hash function for a string
-inline int32_t Hash(const char *inKey)
+// mixing step for the string hash: the folded 128 bit product, as in wyhash.
+const uint64_t kHashPrime0 = 0xa0761d6478bd642fULL;
+const uint64_t kHashPrime1 = 0xe7037ed1a0b428dbULL;
+
+inline uint64_t HashMix(uint64_t a, uint64_t b)
 {
-    // the one-at-a-time hash.
-    // a very good hash function. ref: a web page by Bob Jenkins.
-    // http://www.burtleburtle.net/bob/hash/doobs.html
-    int32_t hash = 0;
-    while (*inKey) {
-        hash += *inKey++;
-        hash += hash << 10;
-        hash ^= hash >> 6;
-    }
-    hash += hash << 3;
-    hash ^= hash >> 11;
-    hash += hash << 15;
-    return hash;
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
 }
 
-// hash function for a string that also returns the length
-inline int32_t Hash(const char *inKey, size_t *outLength)
+inline uint64_t HashLoad(const char *p, size_t n)
 {
-    // the one-at-a-time hash.
-    // a very good hash function. ref: a web page by Bob Jenkins.
-    const char *origKey = inKey;
-    int32_t hash = 0;
-    while (*inKey) {
-        hash += *inKey++;
-        hash += hash << 10;
-        hash ^= hash >> 6;
-    }
-    hash += hash << 3;
-    hash ^= hash >> 11;
-    hash += hash << 15;
-    *outLength = inKey - origKey;
-    return hash;
+    // little endian load of n <= 8 bytes, zero filled.
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+#if BYTE_ORDER == BIG_ENDIAN
+    w = __builtin_bswap64(w);
+#endif
+    return w;
 }
 
 // hash function for an array of char 
 inline int32_t Hash(const char *inKey, size_t inLength)
 {
-    // the one-at-a-time hash.
-    // a very good hash function. ref: a web page by Bob Jenkins.
-    int32_t hash = 0;
-    for (size_t i=0; i<inLength; ++i) {
-        hash += *inKey++;
-        hash += hash << 10;
-        hash ^= hash >> 6;
+    // word at a time hash, eight bytes per multiply.
+    uint64_t hash = kHashPrime0 ^ inLength;
+    size_t i = 0;
+    for (; i + 8 <= inLength; i += 8) {
+        hash = HashMix(HashLoad(inKey + i, 8) ^ kHashPrime1, hash ^ kHashPrime0);
     }
-    hash += hash << 3;
-    hash ^= hash >> 11;
-    hash += hash << 15;
-    return hash;
+    hash = HashMix(HashLoad(inKey + i, inLength - i) ^ kHashPrime1, hash ^ kHashPrime0);
+    hash = HashMix(hash, kHashPrime1);
+    return (int32_t)(hash ^ (hash >> 32));
+}
+
+// hash function for a string
+inline int32_t Hash(const char *inKey)
+{
+    return Hash(inKey, strlen(inKey));
+}
+
+// hash function for a string that also returns the length
+inline int32_t Hash(const char *inKey, size_t *outLength)
+{
+    *outLength = strlen(inKey);
+    return Hash(inKey, *outLength);
 }
 
 // hash function for integers
@@ -11,9 +11,13 @@
 #include <os/lock.h>
 #include <stdio.h>
 #include <sys/stat.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #define CODE_BUFFER_SIZE 4096
+#define DEFAULT_EXPORT_SIZE 256 // numeric list elements sent per outlet call
+#define MAX_EXPORT_SIZE 32768
 
 // enums for inlets / outlets
 enum INLETS { I_INPUT, NUM_INLETS };
@@ -33,6 +37,7 @@ extern void AddMidiOps();
 #include "ext_obex.h"      // required for "new" style objects
 #include "ext_systhread.h" // Max's thread-safe primitives
 #include "z_dsp.h"         // required for MSP objects
+#include "ext_buffer.h"      // buffer~ access for exporting large results
 
 
 // Threading Model:
@@ -42,6 +47,27 @@ extern void AddMidiOps();
 // - audioStateLock: Protects shared audio state between main and audio threads
 // - ZIn audioExtractor: Copied to audio thread to avoid cross-thread access
 
+// Incremental recompilation ('incremental 1'):
+// the code is split into top level statements, each an assignment ending in '= name',
+// '= (a b)' or '= [a b]', or a trailing expression. a statement is compiled only when its
+// text is new, and run only when it is new or uses a name that a statement run earlier in
+// the same pass has just redefined. statements should pass values by name, not on the stack.
+struct SapfStatement {
+    std::string text;
+    std::vector<std::string> defines; // names bound by the statement
+    std::vector<std::string> uses;    // every word in the statement
+};
+
+struct SapfCachedStatement {
+    P<Fun> fun;
+    std::vector<std::string> defines; // names bound by the statement, to tell when they are removed
+    bool stale = false;               // true if it must run again, because an earlier pass stopped before it
+};
+
+struct SapfStatementCache {
+    std::unordered_map<std::string, SapfCachedStatement> functions; // compiled statements keyed by their text
+};
+
 // struct to represent the object's state
 typedef struct _sapf {
     t_pxobject ob; // the object itself (Max MSP object)
@@ -59,6 +85,10 @@ typedef struct _sapf {
     P<Fun> compiledFunction; // Currently compiled sapf function
     char* lastSapfCode;      // Last compiled sapf code string for change detection
 
+    // Incremental recompilation of changed statements
+    bool incremental;                    // True to split code into statements and rerun only changed ones
+    SapfStatementCache* statementCache;  // Compiled statements from the last incremental pass
+
     // Audio extraction interface (lock-free access via atomics)
     ZIn audioExtractor;     // Interface for extracting audio from sapf results
                             // (single channel)
@@ -85,6 +115,12 @@ typedef struct _sapf {
 
     // non-audio outlet
     void * text_outlet;
+
+    // Stack export to the text outlet
+    long exportSize;                 // Longest numeric list sent as atoms in one outlet call
+    t_atom* exportAtoms;             // Reused atom storage, exportSize long
+    t_buffer_ref* exportBufferRef;   // Longer lists go to this buffer~ when set
+    t_symbol* exportBufferName;
 } t_sapf;
 
 // method prototypes
@@ -100,6 +136,11 @@ void sapf_status(t_sapf* x);
 void sapf_help(t_sapf* x);
 void sapf_stack(t_sapf* x);
 void sapf_clear(t_sapf* x);
+void sapf_incremental(t_sapf* x, long n);
+void sapf_exportsize(t_sapf* x, long n);
+void sapf_exportbuffer(t_sapf* x, t_symbol* name);
+void sapf_set(t_sapf* x, t_symbol* s, long argc, t_atom* argv);
+t_max_err sapf_notify(t_sapf* x, t_symbol* s, t_symbol* msg, void* sender, void* data);
 
 // Max-specific audio functions
 void addMaxSpecificOps();
@@ -113,6 +154,19 @@ void reportSapfError(t_sapf* x, const char* codeBuffer, const std::exception& e)
 // global class pointer variable
 static t_class* sapf_class = NULL;
 
+// Selectors for the text outlet, looked up once in ext_main
+static t_symbol* ps_stack;
+static t_symbol* ps_value;
+static t_symbol* ps_list;
+static t_symbol* ps_object_type;
+static t_symbol* ps_buffer;
+static t_symbol* ps_stack_empty;
+static t_symbol* ps_complex_list;
+static t_symbol* ps_large_list;
+static t_symbol* ps_infinite_list;
+static t_symbol* ps_unknown_object;
+static t_symbol* ps_error;
+
 // Global reference to current sapf object for Max audio integration
 static t_sapf* gCurrentSapfObject = nullptr;
 
@@ -251,10 +305,112 @@ void addMaxSpecificOps()
     }
 }
 
+// Type name symbols for the 'object' message. TypeName() returns string literals, so
+// the pointer is a stable key and gensym runs once per type rather than once per item.
+static t_symbol* sapf_typeSymbol(const char* typeName)
+{
+    static std::unordered_map<const char*, t_symbol*> typeSymbols;
+    auto found = typeSymbols.find(typeName);
+    if (found != typeSymbols.end())
+        return found->second;
+    t_symbol* sym = gensym(typeName);
+    typeSymbols[typeName] = sym;
+    return sym;
+}
+
+// Copy a packed numeric array into the export buffer~, resizing it to fit.
+// Multichannel buffers get the values in their first channel.
+static bool sapf_writeExportBuffer(t_sapf* x, Array* arr)
+{
+    if (!x->exportBufferRef)
+        return false;
+
+    t_buffer_obj* buffer = buffer_ref_getobject(x->exportBufferRef);
+    if (!buffer) {
+        post("sapf~: export buffer~ %s not found", x->exportBufferName->s_name);
+        return false;
+    }
+
+    int64_t n = arr->size();
+    if (buffer_getframecount(buffer) != n) {
+        t_atom sizeAtom;
+        atom_setlong(&sizeAtom, n);
+        object_method_typed(buffer, gensym("sizeinsamps"), 1, &sizeAtom, nullptr);
+    }
+
+    float* samples = buffer_locksamples(buffer);
+    if (!samples)
+        return false;
+
+    long numChannels = (long)buffer_getchannelcount(buffer);
+    int64_t numFrames = std::min<int64_t>(n, buffer_getframecount(buffer));
+    if (arr->isZ()) {
+        const Z* z = arr->z();
+        for (int64_t i = 0; i < numFrames; ++i)
+            samples[i * numChannels] = (float)z[i];
+    } else {
+        const V* v = arr->v();
+        for (int64_t i = 0; i < numFrames; ++i)
+            samples[i * numChannels] = v[i].isReal() ? (float)v[i].f : 0.f;
+    }
+
+    buffer_unlocksamples(buffer);
+    buffer_setdirty(buffer);
+
+    t_atom info[2];
+    atom_setsym(&info[0], x->exportBufferName);
+    atom_setlong(&info[1], numFrames);
+    outlet_anything(x->text_outlet, ps_buffer, 2, info);
+    return true;
+}
+
+// Output a finite list: as one 'list' message of up to exportSize numbers, or through
+// the export buffer~ when longer. Packed signal arrays are read directly.
+static void sapf_outputList(t_sapf* x, List* list)
+{
+    Thread& th = *x->sapfThread;
+
+    // Packing stops as soon as the list exceeds what can be sent, unless a buffer~ can take it all.
+    P<List> packed = x->exportBufferRef ? list->pack(th) : list->pack(th, (int)x->exportSize);
+    if (!packed || packed->mArray->size() > x->exportSize) {
+        int64_t size = packed ? packed->mArray->size() : -1;
+        if (packed && sapf_writeExportBuffer(x, packed->mArray()))
+            return;
+        t_atom info[2];
+        atom_setsym(&info[0], ps_large_list);
+        atom_setlong(&info[1], size);
+        outlet_anything(x->text_outlet, ps_value, size >= 0 ? 2 : 1, info);
+        return;
+    }
+
+    Array* arr = packed->mArray();
+    t_atom* atoms = x->exportAtoms;
+    long atomCount = 0;
+    if (arr->isZ()) {
+        const Z* z = arr->z();
+        for (int64_t j = 0; j < arr->size(); ++j)
+            atom_setfloat(&atoms[atomCount++], z[j]);
+    } else {
+        const V* v = arr->v();
+        for (int64_t j = 0; j < arr->size(); ++j) {
+            if (v[j].isReal())
+                atom_setfloat(&atoms[atomCount++], v[j].f);
+        }
+    }
+
+    if (atomCount > 0) {
+        outlet_anything(x->text_outlet, ps_list, atomCount, atoms);
+    } else {
+        t_atom listSymbol;
+        atom_setsym(&listSymbol, ps_complex_list);
+        outlet_anything(x->text_outlet, ps_value, 1, &listSymbol);
+    }
+}
+
 // Output current stack contents to Max text outlet (like sapf REPL)
 void outputStackToTextOutlet(t_sapf* x)
 {
-    if (!x || !x->sapfThread || !x->text_outlet) {
+    if (!x || !x->sapfThread || !x->text_outlet || !x->exportAtoms) {
         return;
     }
 
@@ -264,8 +420,8 @@ void outputStackToTextOutlet(t_sapf* x)
         if (stackDepth == 0) {
             // Output empty stack indicator (like REPL prompt)
             t_atom emptyAtom;
-            atom_setsym(&emptyAtom, gensym("stack_empty"));
-            outlet_anything(x->text_outlet, gensym("stack"), 1, &emptyAtom);
+            atom_setsym(&emptyAtom, ps_stack_empty);
+            outlet_anything(x->text_outlet, ps_stack, 1, &emptyAtom);
         } else {
             // Output each stack item
             for (size_t i = 0; i < stackDepth; i++) {
@@ -276,66 +432,42 @@ void outputStackToTextOutlet(t_sapf* x)
                     // Convert sapf value to Max-compatible output
                     if (stackItem.isReal()) {
                         t_atom valueAtom;
-                        atom_setfloat(&valueAtom, (float)stackItem.asFloat());
-                        outlet_anything(x->text_outlet, gensym("value"), 1, &valueAtom);
+                        atom_setfloat(&valueAtom, stackItem.asFloat());
+                        outlet_anything(x->text_outlet, ps_value, 1, &valueAtom);
 
                     } else if (stackItem.isList()) {
-                        // For lists, output a formatted representation
-                        P<List> list = (List*)stackItem.o();
-                        if (list && list->isFinite()) {
-                            Array* arr = list->mArray.get();
-                            if (arr && arr->size() <= 10) { // Limit output size
-                                t_atom listAtoms[10];
-                                int atomCount = 0;
-
-                                for (size_t j = 0; j < (size_t)arr->size() && atomCount < 10; j++) {
-                                    V item = arr->at(j);
-                                    if (item.isReal()) {
-                                        atom_setfloat(&listAtoms[atomCount], (float)item.asFloat());
-                                        atomCount++;
-                                    }
-                                }
-
-                                if (atomCount > 0) {
-                                    outlet_anything(x->text_outlet, gensym("list"), atomCount, listAtoms);
-                                } else {
-                                    t_atom listSymbol;
-                                    atom_setsym(&listSymbol, gensym("[complex_list]"));
-                                    outlet_anything(x->text_outlet, gensym("value"), 1, &listSymbol);
-                                }
-                            } else {
-                                t_atom listSymbol;
-                                atom_setsym(&listSymbol, gensym("[large_list]"));
-                                outlet_anything(x->text_outlet, gensym("value"), 1, &listSymbol);
-                            }
+                        List* list = (List*)stackItem.o();
+                        if (list->isFinite()) {
+                            sapf_outputList(x, list);
                         } else {
                             t_atom listSymbol;
-                            atom_setsym(&listSymbol, gensym("[infinite_list]"));
-                            outlet_anything(x->text_outlet, gensym("value"), 1, &listSymbol);
+                            atom_setsym(&listSymbol, ps_infinite_list);
+                            outlet_anything(x->text_outlet, ps_value, 1, &listSymbol);
                         }
 
                     } else if (stackItem.isObject()) {
                         // For other objects, output their type
-                        Object* obj = stackItem.o();
-                        if (obj) {
-                            const char* typeName = obj->TypeName();
-                            if (typeName) {
-                                t_atom typeAtom;
-                                atom_setsym(&typeAtom, gensym(typeName));
-                                outlet_anything(x->text_outlet, gensym("object"), 1, &typeAtom);
-                            } else {
-                                t_atom unknownAtom;
-                                atom_setsym(&unknownAtom, gensym("[unknown_object]"));
-                                outlet_anything(x->text_outlet, gensym("value"), 1, &unknownAtom);
-                            }
+                        const char* typeName = stackItem.o()->TypeName();
+                        t_atom typeAtom;
+                        if (typeName) {
+                            atom_setsym(&typeAtom, sapf_typeSymbol(typeName));
+                            outlet_anything(x->text_outlet, ps_object_type, 1, &typeAtom);
+                        } else {
+                            atom_setsym(&typeAtom, ps_unknown_object);
+                            outlet_anything(x->text_outlet, ps_value, 1, &typeAtom);
                         }
                     }
 
                 } catch (const std::exception& e) {
                     post("sapf~: Error outputting stack item %zu: %s", i, e.what());
                     t_atom errorAtom;
-                    atom_setsym(&errorAtom, gensym("[error]"));
-                    outlet_anything(x->text_outlet, gensym("value"), 1, &errorAtom);
+                    atom_setsym(&errorAtom, ps_error);
+                    outlet_anything(x->text_outlet, ps_value, 1, &errorAtom);
+                } catch (int) {
+                    post("sapf~: Error outputting stack item %zu", i);
+                    t_atom errorAtom;
+                    atom_setsym(&errorAtom, ps_error);
+                    outlet_anything(x->text_outlet, ps_value, 1, &errorAtom);
                 }
             }
         }
@@ -445,6 +577,9 @@ ExecutionResult sapf_executeCode(t_sapf* x, P<Fun> compiledFunction);
 AudioProcessingResult sapf_processAudioResult(t_sapf* x, const V& audioResult);
 AudioProcessingResult sapf_handleMultiChannelAudio(t_sapf* x, const V& audioResult, const char* resultType);
 void sapf_reportStatus(t_sapf* x, bool compilationError, bool hasValidAudio, P<Fun> compiledFunction);
+std::vector<SapfStatement> sapf_splitStatements(const std::string& codeBuffer);
+void sapf_runIncremental(t_sapf* x, const std::string& codeBuffer);
+bool sapf_compileStatement(t_sapf* x, const std::string& text, P<Fun>& outFun);
 
 // Enhanced error reporting with specific error type detection and user
 // guidance
@@ -525,6 +660,23 @@ void ext_main(void* r)
     class_addmethod(c, (method)sapf_help, "help", 0);
     class_addmethod(c, (method)sapf_stack, "stack", 0);
     class_addmethod(c, (method)sapf_clear, "clear", 0);
+    class_addmethod(c, (method)sapf_incremental, "incremental", A_LONG, 0);
+    class_addmethod(c, (method)sapf_exportsize, "exportsize", A_LONG, 0);
+    class_addmethod(c, (method)sapf_exportbuffer, "exportbuffer", A_DEFSYM, 0);
+    class_addmethod(c, (method)sapf_set, "set", A_GIMME, 0);
+    class_addmethod(c, (method)sapf_notify, "notify", A_CANT, 0);
+
+    ps_stack = gensym("stack");
+    ps_value = gensym("value");
+    ps_list = gensym("list");
+    ps_object_type = gensym("object");
+    ps_buffer = gensym("buffer");
+    ps_stack_empty = gensym("stack_empty");
+    ps_complex_list = gensym("[complex_list]");
+    ps_large_list = gensym("[large_list]");
+    ps_infinite_list = gensym("[infinite_list]");
+    ps_unknown_object = gensym("[unknown_object]");
+    ps_error = gensym("[error]");
 
     class_dspinit(c);
     class_register(CLASS_BOX, c);
@@ -541,6 +693,10 @@ void* sapf_new(t_symbol* s, long argc, t_atom* argv)
         
         // general (non-audio) outlet
         x->text_outlet = outlet_new((t_object *)x, NULL);
+        x->exportSize = DEFAULT_EXPORT_SIZE;
+        x->exportAtoms = new t_atom[DEFAULT_EXPORT_SIZE];
+        x->exportBufferRef = nullptr;
+        x->exportBufferName = nullptr;
 
         // audio (signal) outlet
         outlet_new(x, "signal"); // signal outlet (note "signal" rather than NULL)
@@ -578,6 +734,8 @@ void* sapf_new(t_symbol* s, long argc, t_atom* argv)
             // Initialize compiled function storage
             x->compiledFunction = P<Fun>(); // Initialize empty smart pointer
             x->lastSapfCode = nullptr;      // No cached code yet
+            x->incremental = false;
+            x->statementCache = new SapfStatementCache();
 
             // Initialize audio extraction interface
             x->audioExtractor = ZIn(); // Initialize empty ZIn (legacy single
@@ -674,12 +832,28 @@ void sapf_free(t_sapf* x)
         x->lastSapfCode = nullptr;
     }
 
+    // Clean up the incremental statement cache
+    if (x->statementCache) {
+        delete x->statementCache;
+        x->statementCache = nullptr;
+    }
+
     // Clean up intermediate audio buffers
     if (x->out_sapf_buffer) {
         delete[] x->out_sapf_buffer;
         x->out_sapf_buffer = nullptr;
     }
 
+    // Clean up stack export storage
+    if (x->exportAtoms) {
+        delete[] x->exportAtoms;
+        x->exportAtoms = nullptr;
+    }
+    if (x->exportBufferRef) {
+        object_free(x->exportBufferRef);
+        x->exportBufferRef = nullptr;
+    }
+
     // Smart pointers (P<Fun>) clean up automatically via destructor
     // ZIn objects clean up automatically via destructor
     // Primitive types (bool, double, char[]) clean up automatically
@@ -711,6 +885,15 @@ void sapf_code(t_sapf* x, t_symbol* s, long argc, t_atom* argv)
 
     std::string codeBuffer = validation.codeBuffer;
 
+    if (x->incremental && x->statementCache) {
+        sapf_runIncremental(x, codeBuffer);
+        if (codeBuffer.find("play") == std::string::npos) {
+            outputStackToTextOutlet(x);
+        }
+        sapf_reportStatus(x, x->compilationError, x->hasValidAudio, x->compiledFunction);
+        return;
+    }
+
     // Check if code has changed (for caching)
     bool needsRecompilation = true;
     if (x->lastSapfCode) {
@@ -1013,6 +1196,10 @@ void sapf_help(t_sapf* x)
     post("  help    - Show this help message");
     post("  stack   - Inspect current sapf stack contents");
     post("  clear   - Clear sapf stack (removes all values)");
+    post("  incremental 0/1 - Recompile and rerun only the statements that changed");
+    post("  exportsize <n>  - Longest numeric list sent from the stack as one message");
+    post("  exportbuffer <name> - Write longer lists into a buffer~ (no name to stop)");
+    post("  set <name> <value> ... - Set named control slots read by 'ctl' in running code");
     post("  Note: Stack values are preserved after code execution for "
          "debugging");
     post("");
@@ -1762,6 +1949,266 @@ void sapf_reportStatus(t_sapf* x, bool compilationError, bool hasValidAudio, P<F
          compiledFunction ? "LOADED" : "NULL");
 }
 
+// Splits code into top level statements for incremental recompilation.
+// follows the parser's lexical rules closely enough to find words, brackets, strings and comments.
+std::vector<SapfStatement> sapf_splitStatements(const std::string& codeBuffer)
+{
+    static const char* nonnamechars = ";()[]{}.`,:\"\n\\";
+    auto isWordChar = [](char c) { return c && !isspace((unsigned char)c) && !strchr(nonnamechars, c); };
+
+    std::vector<SapfStatement> statements;
+    SapfStatement current;
+    const char* code = codeBuffer.c_str();
+    const char* start = code;
+    const char* s = code;
+    int depth = 0;
+
+    auto finish = [&](const char* end) {
+        while (start < end && isspace((unsigned char)*start)) ++start;
+        if (start < end) {
+            current.text.assign(start, end - start);
+            statements.push_back(std::move(current));
+        }
+        current = SapfStatement();
+        start = end;
+    };
+
+    while (*s) {
+        char c = *s;
+        if (c == ';') {
+            while (*s && *s != '\n') ++s;
+        } else if (c == '"') {
+            ++s;
+            while (*s && !(*s == '"' && s[1] != '"')) s += (*s == '"') ? 2 : 1;
+            if (*s) ++s;
+        } else if (c == '(' || c == '[' || c == '{') {
+            ++depth;
+            ++s;
+        } else if (c == ')' || c == ']' || c == '}') {
+            if (depth) --depth;
+            ++s;
+        } else if (isWordChar(c)) {
+            const char* word = s;
+            while (isWordChar(*s)) ++s;
+            if (depth || s - word != 1 || *word != '=') {
+                current.uses.emplace_back(word, s - word);
+                continue;
+            }
+            // an assignment ends the statement after the names it binds.
+            while (*s && isspace((unsigned char)*s)) ++s;
+            char close = *s == '(' ? ')' : *s == '[' ? ']' : 0;
+            if (close) ++s;
+            do {
+                while (*s && isspace((unsigned char)*s)) ++s;
+                const char* name = s;
+                while (isWordChar(*s)) ++s;
+                if (s == name) break;
+                current.defines.emplace_back(name, s - name);
+            } while (close);
+            while (close && *s && *s != close) ++s;
+            if (close && *s) ++s;
+            finish(s);
+        } else {
+            ++s;
+        }
+    }
+    finish(s);
+    return statements;
+}
+
+// Compiles one statement for an incremental pass. Unlike sapf_compileCode, this leaves the object's
+// compiled function, code cache and audio state alone.
+bool sapf_compileStatement(t_sapf* x, const std::string& text, P<Fun>& outFun)
+{
+    outFun = P<Fun>();
+    try {
+        if (x->sapfThread->compile(text.c_str(), outFun, true) && outFun) {
+            return true;
+        }
+        snprintf_zero(x->errorMessage, sizeof(x->errorMessage), "Compilation failed: %s", text.c_str());
+    } catch (const std::exception& e) {
+        snprintf_zero(x->errorMessage, sizeof(x->errorMessage), "Exception: %s", e.what());
+        reportSapfError(x, text.c_str(), e);
+    } catch (...) {
+        snprintf_zero(x->errorMessage, sizeof(x->errorMessage), "Unknown exception during compilation");
+    }
+    outFun = P<Fun>();
+    x->compilationError = true;
+    return false;
+}
+
+// Compiles and runs the statements of the code that changed since the last pass, or that use a
+// name redefined or removed by one that did.
+void sapf_runIncremental(t_sapf* x, const std::string& codeBuffer)
+{
+    std::vector<SapfStatement> statements = sapf_splitStatements(codeBuffer);
+    std::unordered_map<std::string, SapfCachedStatement>& cache = x->statementCache->functions;
+    std::unordered_map<std::string, SapfCachedStatement> functions;
+    std::unordered_set<std::string> redefined;
+    size_t numCompiled = 0;
+    size_t numRun = 0;
+    bool stopped = false;
+
+    x->compilationError = false;
+
+    // names bound by statements that are gone count as changed.
+    std::unordered_set<std::string> texts;
+    for (SapfStatement const& statement : statements) {
+        texts.insert(statement.text);
+    }
+    for (auto const& cached : cache) {
+        if (!texts.count(cached.first)) {
+            redefined.insert(cached.second.defines.begin(), cached.second.defines.end());
+        }
+    }
+
+    for (SapfStatement& statement : statements) {
+        auto cached = cache.find(statement.text);
+        bool isNew = cached == cache.end();
+        bool dirty = isNew || cached->second.stale;
+        for (size_t i = 0; !dirty && i < statement.uses.size(); ++i) {
+            dirty = redefined.count(statement.uses[i]) != 0;
+        }
+        if (dirty) {
+            redefined.insert(statement.defines.begin(), statement.defines.end());
+        }
+
+        // after a failure the rest keep their compiled code, and those that needed to run
+        // are marked to run on the next pass.
+        if (stopped) {
+            if (!isNew) {
+                SapfCachedStatement& entry = functions[statement.text];
+                entry = cached->second;
+                entry.stale = dirty;
+            }
+            continue;
+        }
+
+        SapfCachedStatement entry;
+        entry.defines = statement.defines;
+        if (isNew) {
+            if (!sapf_compileStatement(x, statement.text, entry.fun)) {
+                error("sapf~: ✗ Incremental compile stopped at: %s", statement.text.c_str());
+                stopped = true;
+                continue;
+            }
+            ++numCompiled;
+        } else {
+            entry.fun = cached->second.fun;
+        }
+
+        if (dirty) {
+            ExecutionResult execution = sapf_executeCode(x, entry.fun);
+            if (!execution.success) {
+                if (!execution.errorMessage.empty()) {
+                    error("sapf~: ✗ %s", execution.errorMessage.c_str());
+                }
+                entry.stale = true;
+                functions[statement.text] = entry;
+                stopped = true;
+                continue;
+            }
+            ++numRun;
+        }
+        functions[statement.text] = entry;
+    }
+
+    // statements that are no longer in the code drop out of the cache.
+    cache.swap(functions);
+    post("sapf~: Incremental - %zu statements, %zu compiled, %zu run",
+         statements.size(), numCompiled, numRun);
+}
+
+void sapf_incremental(t_sapf* x, long n)
+{
+    if (!x || !x->statementCache) {
+        error("sapf~: Invalid object pointer");
+        return;
+    }
+
+    x->incremental = n != 0;
+    x->statementCache->functions.clear();
+    post("sapf~: Incremental recompilation %s", x->incremental ? "on" : "off");
+}
+
+void sapf_exportsize(t_sapf* x, long n)
+{
+    if (!x) {
+        error("sapf~: Invalid object pointer");
+        return;
+    }
+
+    n = std::clamp<long>(n, 1, MAX_EXPORT_SIZE);
+    delete[] x->exportAtoms;
+    x->exportAtoms = new t_atom[n];
+    x->exportSize = n;
+    post("sapf~: Stack export sends lists of up to %ld numbers", n);
+}
+
+void sapf_exportbuffer(t_sapf* x, t_symbol* name)
+{
+    if (!x) {
+        error("sapf~: Invalid object pointer");
+        return;
+    }
+
+    if (!name || name == gensym("")) {
+        if (x->exportBufferRef) {
+            object_free(x->exportBufferRef);
+            x->exportBufferRef = nullptr;
+        }
+        x->exportBufferName = nullptr;
+        post("sapf~: Stack export buffer~ off");
+        return;
+    }
+
+    if (x->exportBufferRef) {
+        buffer_ref_set(x->exportBufferRef, name);
+    } else {
+        x->exportBufferRef = buffer_ref_new((t_object*)x, name);
+    }
+    x->exportBufferName = name;
+    post("sapf~: Lists longer than %ld go to buffer~ %s", x->exportSize, name->s_name);
+}
+
+// 'set name value [name value ...]' stores values in named control slots.
+// running graphs read them with 'ctl' without locking, so this is safe at control rate.
+void sapf_set(t_sapf* x, t_symbol* s, long argc, t_atom* argv)
+{
+    if (!x) {
+        error("sapf~: Invalid object pointer");
+        return;
+    }
+
+    if (argc < 2 || (argc & 1)) {
+        error("sapf~: set expects name value pairs");
+        return;
+    }
+
+    for (long i = 0; i < argc; i += 2) {
+        if (atom_gettype(argv + i) != A_SYM) {
+            error("sapf~: set expects a name at argument %ld", i + 1);
+            return;
+        }
+        long type = atom_gettype(argv + i + 1);
+        if (type != A_FLOAT && type != A_LONG) {
+            error("sapf~: set expects a number for %s", atom_getsym(argv + i)->s_name);
+            return;
+        }
+    }
+
+    for (long i = 0; i < argc; i += 2) {
+        setControl(atom_getsym(argv + i)->s_name, atom_getfloat(argv + i + 1));
+    }
+}
+
+t_max_err sapf_notify(t_sapf* x, t_symbol* s, t_symbol* msg, void* sender, void* data)
+{
+    if (x->exportBufferRef)
+        return buffer_ref_notify(x->exportBufferRef, s, msg, sender, data);
+    return MAX_ERR_NONE;
+}
+
 void sapf_clear(t_sapf* x)
 {
     if (!x) {
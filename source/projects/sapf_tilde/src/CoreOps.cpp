@@ -16,6 +16,7 @@
 
 #include "VM.hpp"
 #include "Parser.hpp"
+#include "Bytecode.hpp"
 #include "clz.hpp"
 #include <string>
 #include <unistd.h>
@@ -974,6 +975,69 @@ static void compile_(Thread& th, Prim* prim)
 	}
 }
 
+static void compileError_(Thread& th, Prim* prim)
+{
+	P<String> s = th.popString("compileError : string");
+	
+	P<List> result = new List(itemTypeZ, 2);
+	P<Fun> fun;
+	try {
+		th.compile(s->s, fun, false);
+	} catch (int err) {
+		if (err != errSyntax) throw;
+		result->addz(th.errorLine);
+		result->addz(th.errorColumn);
+	}
+	th.push(result);
+}
+
+static bool readTextFile(const char* path, std::string& text)
+{
+	FILE* f = fopen(path, "r");
+	if (!f) return false;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+	fclose(f);
+	return true;
+}
+
+static void saveCompiled_(Thread& th, Prim* prim)
+{
+	P<String> bytecodePath = th.popString("saveCompiled : bytecodePath");
+	P<String> sourcePath = th.popString("saveCompiled : sourcePath");
+	
+	std::string source;
+	if (!readTextFile(sourcePath->s, source)) {
+		post("could not open '%s'\n", sourcePath->s);
+		throw errFailed;
+	}
+	P<Fun> fun;
+	if (!th.compile(source.c_str(), fun, true) || !saveBytecodeFile(th, fun->mDef, bytecodePath->s)) {
+		throw errFailed;
+	}
+}
+
+static void loadCompiled_(Thread& th, Prim* prim)
+{
+	P<String> path = th.popString("loadCompiled : bytecodePath");
+	P<FunDef> def = loadBytecodeFile(th, path->s);
+	P<Fun> fun = new Fun(th, def());
+	fun->run(th);
+}
+
+static void checkCompiled_(Thread& th, Prim* prim)
+{
+	P<String> path = th.popString("checkCompiled : bytecodePath");
+	bool ok = true;
+	try {
+		loadBytecodeFile(th, path->s);
+	} catch (...) {
+		ok = false;
+	}
+	th.pushBool(ok);
+}
+
 static void y_combinator_call_(Thread& th, Prim* prim)
 {
 	th.push(prim);
@@ -1096,9 +1160,8 @@ static void helpbifs_(Thread& th, Prim* prim)
 {
     post("\nBUILT IN FUNCTIONS\n\n");
 
-	for (size_t i = 0; i < vm.bifHelp.size(); ++i) {
-		std::string& s = vm.bifHelp[i];
-		post(" %s\n", s.c_str());
+	for (BifHelp const& h : vm.bifHelp) {
+		post(" %s%s%s%s%s\n", h.name, h.mask ? " @" : "", h.mask ? h.mask : "", h.help ? " " : "", h.help ? h.help : "");
 	}
 }
 
@@ -1263,6 +1326,61 @@ struct ZPlugOut : Gen
 };
 
 
+struct ControlOut : Gen
+{
+	P<Control> _control;
+	Z _prev;
+	bool _smooth;
+	
+	ControlOut(Thread& th, P<Control> const& inControl, bool inSmooth)
+		: Gen(th, itemTypeZ, false), _control(inControl), _prev(inControl->getControl()), _smooth(inSmooth)
+	{
+	}
+	virtual const char* TypeName() const override { return "ControlOut"; }
+    	
+	virtual void pull(Thread& th) override {
+		// one atomic read per block.
+		Z z = _control->getControl();
+		int n = mBlockSize;
+		Z* out = mOut->fulfillz(n);
+		if (_smooth && z != _prev) {
+			Z step = (z - _prev) / n;
+			Z prev = _prev;
+			for (int i = 0; i < n - 1; ++i) {
+				out[i] = prev + (i + 1) * step;
+			}
+			out[n-1] = z;
+		} else {
+			for (int i = 0; i < n; ++i) {
+				out[i] = z;
+			}
+		}
+		_prev = z;
+		produce(0);
+	}
+};
+
+static void ctl_(Thread& th, Prim* prim)
+{
+	P<String> name = th.popString("ctl : name");
+	Z value = th.popFloat("ctl : value");
+	th.push(new List(new ControlOut(th, getControl(name, value), true)));
+}
+
+static void ctlstep_(Thread& th, Prim* prim)
+{
+	P<String> name = th.popString("ctlstep : name");
+	Z value = th.popFloat("ctlstep : value");
+	th.push(new List(new ControlOut(th, getControl(name, value), false)));
+}
+
+static void setctl_(Thread& th, Prim* prim)
+{
+	P<String> name = th.popString("setctl : name");
+	Z value = th.popFloat("setctl : value");
+	getControl(name, value)->setControl(value);
+}
+
 static void plug_(Thread& th, Prim* prim)
 {
 	V in = th.pop();
@@ -1413,6 +1531,9 @@ void AddCoreOps()
 	vm.def("ZR", 1, 1, zref_, "(z --> r) create a new ZRef with the inital value z. A ZRefs is a mutable reference to a real number.");
 	vm.def("P", 1, 2, plug_, "(a --> out in) create a new stream plug pair with the inital value a");
 	vm.def("ZP", 1, 2, zplug_, "(a --> out in) create a new signal plug pair with the inital value a.");
+	DEF(ctl, 2, "(value name --> out) returns a signal that reads the named control slot once per block, ramping over the block when it changes. The slot is made with the initial value if it does not exist. sapf~ sets slots with 'set name value' messages.")
+	DEF(ctlstep, 2, "(value name --> out) like ctl but changes step at block boundaries without ramping.")
+	DEFnoeach(setctl, 2, 0, "(value name -->) store the value in the named control slot.")
 	
 	
 	//DEF(bind, 2, "deprecated")
@@ -1424,6 +1545,10 @@ void AddCoreOps()
 	vm.def("!", 1, -1, apply_, "(... f --> ...) apply the function to its arguments, observing @ arguments as appropriate.");
 	vm.def("!e", 2, -1, applyEvent_, "(form fun --> ...) for each argument in the function, find the same named fields in the form and push those values as arguments to the function.");
 	DEF(compile, 1, "(string --> fun) compile the string and return a function.")
+	DEF(compileError, 1, "(string --> [line column]) compile the string and return where its syntax error is, or an empty list if it compiles.")
+	DEF2(saveCompiled, 2, 0, "(sourcePath bytecodePath -->) compile a source file and save it as bytecode, which loadCompiled runs without parsing.")
+	DEF2(loadCompiled, 1, 0, "(bytecodePath -->) load and run a bytecode file saved by saveCompiled.")
+	DEF(checkCompiled, 1, "(bytecodePath --> bool) return whether a bytecode file can be loaded, without running it.")
 	
 	vm.addBifHelp("\n*** printing ops ***");
 	DEFnoeach(printLength, 0, 1, "(--> length) return the number of items printed for lists.");
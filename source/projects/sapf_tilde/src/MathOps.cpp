@@ -1198,12 +1198,12 @@ DEFINE_BINOP_FLOAT(roundUp, sc_roundUp(a, b))
 DEFINE_BINOP_FLOAT(trunc, sc_trunc(a, b))
 
 
-#define DEFN(FUNNAME, OPNAME, HELP) 	vm.def(OPNAME, 1, 1, FUNNAME##_, "(x --> z) " HELP);
+#define DEFN(FUNNAME, OPNAME, HELP) 	vm.def(OPNAME, 1, 1, FUNNAME##_, "(x --> z) " HELP).SetPure();
 #define DEFNa(FUNNAME, OPNAME, HELP) 	DEFN(FUNNAME, #OPNAME, HELP)
 #define DEF(NAME, HELP) 	DEFNa(NAME, NAME, HELP); 
 
 #define DEFNa2(FUNNAME, OPNAME, HELP) 	\
-	(vm.def(#OPNAME, 2, 1, FUNNAME##_, "(x y --> z) " HELP), \
+	(vm.def(#OPNAME, 2, 1, FUNNAME##_, "(x y --> z) " HELP).SetPure(), \
 	vm.def(#OPNAME "/", 1, 1, FUNNAME##_reduce_, nullptr), \
 	vm.def(#OPNAME "\\", 1, 1, FUNNAME##_scan_, nullptr), \
 	vm.def(#OPNAME "^", 1, 1, FUNNAME##_pairs_, nullptr), \
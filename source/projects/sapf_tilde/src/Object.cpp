@@ -19,8 +19,10 @@
 #include "clz.hpp"
 #include "MathOps.hpp"
 #include "Opcode.hpp"
+#include "symbol.hpp"
 #include <algorithm>
 #include <cstdarg>
+#include <unordered_map>
 
 #ifndef SAPF_TILDE
 void post(const char* fmt, ...)
@@ -150,7 +152,8 @@ Z ZRef::derefz() const
 
 
 Form::Form(P<Table> const& inTable, P<Form> const& inNext)
-	: Object(), mTable(inTable), mNextForm(inNext)
+	: Object(), mTable(inTable), mNextForm(inNext),
+	mShape(FormShape::shapeFor(inTable, inNext))
 {
 }
 
@@ -360,16 +363,74 @@ void Prim::apply_n(Thread& th, size_t n)
 }
 
 bool Form::get(Thread& th, Arg key, V& value) const
+{
+	if (!mShape()) {
+		const Form* e = this;
+		int64_t hash = key.Hash();
+		do {
+			if (e->mTable() && e->mTable->getWithHash(th, key, hash, value)) {
+				return true;
+			}
+			e = (Form*)e->mNextForm();
+		} while (e);
+		return false;
+	}
+
+	FormSlot slot;
+	if (!mShape->lookup(key, key.Hash(), slot))
+		return false;
+	value = valueAt(slot);
+	return true;
+}
+
+V Form::valueAt(FormSlot slot) const
 {
     const Form* e = this;
-	int64_t hash = key.Hash();
-    do {
-       if (e->mTable->getWithHash(th, key, hash, value)) {
-           return true;
-        }
-        e = (Form*)e->mNextForm();
-    } while (e);
-    return false;
+	for (int32_t i = 0; i < slot.depth; ++i) {
+		e = e->mNextForm();
+	}
+	return e->mTable->mValues[slot.index];
+}
+
+// an inline cache entry packs the shape serial number with the slot. zero is never a serial number.
+const int kFormCacheDepthBits = 12;
+const int kFormCacheIndexBits = 20;
+
+bool Form::getCached(Thread& th, Arg key, uint64_t& ioCache, V& value) const
+{
+	if (!mShape() || mShape->mID == 0) {
+		return get(th, key, value);
+	}
+	
+	uint64_t entry = __atomic_load_n(&ioCache, __ATOMIC_RELAXED);
+	if ((uint32_t)(entry >> 32) == mShape->mID) {
+		FormSlot slot;
+		slot.depth = (int32_t)(entry >> kFormCacheIndexBits) & ((1 << kFormCacheDepthBits) - 1);
+		slot.index = (int32_t)entry & ((1 << kFormCacheIndexBits) - 1);
+		value = valueAt(slot);
+		return true;
+	}
+	
+	FormSlot slot;
+	if (!mShape->lookup(key, key.Hash(), slot))
+		return false;
+	if (slot.depth < (1 << kFormCacheDepthBits) && slot.index < (1 << kFormCacheIndexBits)) {
+		entry = ((uint64_t)mShape->mID << 32) | ((uint64_t)slot.depth << kFormCacheIndexBits) | (uint64_t)slot.index;
+		__atomic_store_n(&ioCache, entry, __ATOMIC_RELAXED);
+	}
+	value = valueAt(slot);
+	return true;
+}
+
+bool Form::dotCached(Thread& th, Arg key, uint64_t& ioCache, V& ioValue)
+{
+	V value;
+	if (getCached(th, key, ioCache, value)) {
+		ioValue = value.msgSend(th, V(this));
+		return true;
+	} else {
+		return false;
+	}
 }
 
 
@@ -690,7 +751,8 @@ int V::Hash() const
             double f;
             uint64_t i;
         } u;
-        u.f = f;
+        // -0 equals 0, so they must hash alike.
+        u.f = f == 0. ? 0. : f;
 		return (int)::Hash64(u.i);
 	}
 }
@@ -1097,13 +1159,23 @@ Array::~Array()
 {
 	if (isV()) {
 		delete [] vv;
-	} else {
+	} else if (!mBase) {
 		free(p);
 	}
 }
 
 void Array::alloc(int64_t inCap)
 {
+	if (mBase) {
+		// a view owns no storage, so it gets its own copy before anything can change.
+		Z* items = zz;
+		// at least one item, since add grows a full array by doubling mCap.
+		mCap = std::max({inCap, mSize, (int64_t)1});
+		zz = (Z*)malloc(mCap * sizeof(Z));
+		memcpy(zz, items, mSize * sizeof(Z));
+		mBase = nullptr;
+		return;
+	}
 	if (mCap >= inCap) return;
 	mCap = inCap;
 	if (isV()) {
@@ -1166,12 +1238,14 @@ void Array::addz(Z inItem)
 
 void Array::put(int64_t inIndex, Arg inItem)
 {
+	if (mBase) alloc(mSize);
 	if (isV()) vv[inIndex] = inItem;
 	else zz[inIndex] = inItem.asFloat();
 }
 
 void Array::putz(int64_t inIndex, Z inItem)
 {
+	if (mBase) alloc(mSize);
 	if (isV()) vv[inIndex] = V(inItem);
 	else zz[inIndex] = inItem;
 }
@@ -1699,7 +1773,7 @@ bool ZIn::fillSegment(Thread& th, int inNum, Z* outBuffer)
 	}
 	
 	Z z = mConstant.f;
-	for (int i = 0; i < framesToFill; ++i) outBuffer[i] = z;
+	for (int i = 0; i < framesToFill; ++i) out[i] = z;
 	
 	mDone = true;
 	return true;
@@ -2142,6 +2216,106 @@ TableMap::~TableMap()
 {
 	delete [] mKeys;
 	delete [] mIndices;
+	
+	FormShape* shape = mShapes.load(std::memory_order_acquire);
+	while (shape) {
+		FormShape* next = shape->mNextShape;
+		shape->release();
+		shape = next;
+	}
+}
+
+////////////////////
+
+std::atomic<uint32_t> gFormShapeSerialNumber = 0;
+
+// past these limits forms have no shape, so that chains built up in a loop do not accumulate shapes
+// for as long as the map lives.
+const int kMaxSharedShapeDepth = 32;
+const int kMaxShapesPerMap = 16;
+
+static uint32_t nextFormShapeID()
+{
+	// a wrapped serial number could match a stale inline cache entry, so they stop at the top.
+	uint32_t id = gFormShapeSerialNumber.load(std::memory_order_relaxed);
+	do {
+		if (id == UINT32_MAX) return 0;
+	} while (!gFormShapeSerialNumber.compare_exchange_weak(id, id + 1, std::memory_order_relaxed));
+	return id + 1;
+}
+
+FormShape::FormShape(TableMap* inMap, P<FormShape> const& inParent)
+	: mParent(inParent), mID(nextFormShapeID()), mChainDepth(inParent() ? inParent->mChainDepth + 1 : 1)
+{
+	size_t ownSize = inMap ? inMap->mSize : 0;
+	size_t parentSize = inParent() ? inParent->mKeys->mSize : 0;
+	size_t cap = ownSize + parentSize;
+
+	mKeys = new TableMap(cap);
+	mSlots = new FormSlot[cap];
+	
+	// the nearest table wins when a key is repeated, as when searching up the chain.
+	size_t size = 0;
+	auto add = [&](Arg key, FormSlot slot) {
+		int64_t hash = key.Hash();
+		size_t index;
+		if (mKeys->getIndex(key, hash, index)) return;
+		mKeys->put(size, key, hash);
+		mSlots[size] = slot;
+		++size;
+	};
+	for (size_t i = 0; i < ownSize; ++i) {
+		add(inMap->mKeys[i], { 0, (int32_t)i });
+	}
+	for (size_t i = 0; i < parentSize; ++i) {
+		FormSlot slot = inParent->mSlots[i];
+		++slot.depth;
+		add(inParent->mKeys->mKeys[i], slot);
+	}
+	mKeys->mSize = size;
+}
+
+FormShape::~FormShape()
+{
+	delete [] mSlots;
+}
+
+P<FormShape> FormShape::shapeFor(P<Table> const& inTable, P<Form> const& inNext)
+{
+	// the empty form has no table to hold its shape.
+	TableMap* map = inTable() ? inTable->mMap() : nullptr;
+	FormShape* parent = inNext() ? inNext->mShape() : nullptr;
+	if (!map || (inNext() && !parent) || (parent && parent->mChainDepth >= kMaxSharedShapeDepth))
+		return nullptr;
+	
+	// lock free: the list only grows at the head, and a shape is complete before it is published.
+	P<FormShape> shape;
+	FormShape* head = map->mShapes.load(std::memory_order_acquire);
+	while (1) {
+		int count = 0;
+		for (FormShape* other = head; other; other = other->mNextShape) {
+			if (other->mParent() == parent) return other;
+			++count;
+		}
+		if (count >= kMaxShapesPerMap) return nullptr;
+		
+		if (!shape()) shape = new FormShape(map, parent);
+		shape->mNextShape = head;
+		if (map->mShapes.compare_exchange_weak(head, shape(), std::memory_order_release, std::memory_order_acquire)) {
+			shape->retain();
+			return shape;
+		}
+		// another thread added a shape first, which may be the one wanted.
+	}
+}
+
+bool FormShape::lookup(Arg inKey, int64_t inKeyHash, FormSlot& outSlot) const
+{
+	size_t index;
+	if (mKeys->mSize == 0 || !mKeys->getIndex(inKey, inKeyHash, index))
+		return false;
+	outSlot = mSlots[index];
+	return true;
 }
 
 bool TableMap::getIndex(Arg inKey, int64_t inKeyHash, size_t& outIndex)
@@ -2380,3 +2554,23 @@ void ZPlug::getPlug(ZIn& outZIn, int& outChangeCount) {
 	outZIn = in;
 	outChangeCount = mChangeCount;
 }
+
+// symbols are unique, so slots are keyed by the String pointer.
+static std::unordered_map<String*, P<Control>> gControls;
+static os_unfair_lock gControlLock = OS_UNFAIR_LOCK_INIT;
+
+P<Control> getControl(P<String> const& inName, Z inValue)
+{
+	// names may also arrive as string literals, which are not interned.
+	P<String> name = getsym(inName->s);
+	SpinLocker lock(gControlLock);
+	P<Control>& control = gControls[name()];
+	if (!control()) control = new Control(name, inValue);
+	return control;
+}
+
+void setControl(const char* inName, Z inValue)
+{
+	P<String> name = getsym(inName);
+	getControl(name, inValue)->setControl(inValue);
+}
@@ -192,6 +192,7 @@ VM::VM()
 	builtins = new GTable();
 	
 	// add built in funs
+	bifHelp.reserve(kBifHelpReserve);
 		
 	_nilz = new List(itemTypeZ);
 	_nilv = new List(itemTypeV);
@@ -20,58 +20,153 @@
 #include <string.h>
 #include <atomic>
 
-const int kSymbolTableSize = 4096;
-const int kSymbolTableMask = kSymbolTableSize - 1;
+// The symbol table is a split-ordered list (Shalev & Shavit). Every symbol lives in one
+// lock-free list sorted by its bit reversed hash, and each bucket points at a dummy node
+// that marks where its run of the list begins. Doubling the number of buckets only adds
+// dummies, no symbol ever moves, so the table grows without locking or rehashing.
+// Symbols are never removed, so an insert is a single compare and swap.
+
+struct SymbolNode
+{
+	uint32_t key; // bit reversed hash. odd for symbols, even for bucket dummies.
+	String* sym;
+	std::atomic<SymbolNode*> next;
 	
+	constexpr SymbolNode(uint32_t inKey, String* inSym) : key(inKey), sym(inSym), next(nullptr) {}
+};
+
+const int kSymbolSegmentBits = 12;
+const uint32_t kSymbolSegmentSize = 1 << kSymbolSegmentBits;
+const uint32_t kSymbolSegmentMask = kSymbolSegmentSize - 1;
+const uint32_t kSymbolMaxSegments = 1024;
+const uint32_t kSymbolMaxBuckets = kSymbolSegmentSize * kSymbolMaxSegments;
+const uint32_t kSymbolMaxLoad = 2; // mean symbols per bucket before the bucket count doubles.
+
 // global atomic symbol table
-volatile std::atomic<String*> sSymbolTable[kSymbolTableSize];
+static SymbolNode sSymbolList(0, nullptr); // the dummy for bucket zero.
+static std::atomic<std::atomic<SymbolNode*>*> sSymbolSegments[kSymbolMaxSegments];
+static std::atomic<uint32_t> sSymbolNumBuckets(kSymbolSegmentSize);
+static std::atomic<uint32_t> sSymbolCount(0);
 
+static uint32_t reverseBits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+	x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+	return (x >> 16) | (x << 16);
+}
 
+static std::atomic<SymbolNode*>* bucketSlot(uint32_t bucket)
+{
+	std::atomic<std::atomic<SymbolNode*>*>& segmentRef = sSymbolSegments[bucket >> kSymbolSegmentBits];
+	std::atomic<SymbolNode*>* segment = segmentRef.load(std::memory_order_acquire);
+	if (!segment) {
+		std::atomic<SymbolNode*>* newSegment = new std::atomic<SymbolNode*>[kSymbolSegmentSize];
+		for (uint32_t i = 0; i < kSymbolSegmentSize; ++i) newSegment[i].store(nullptr, std::memory_order_relaxed);
+		if (segmentRef.compare_exchange_strong(segment, newSegment, std::memory_order_acq_rel)) {
+			segment = newSegment;
+		} else {
+			delete [] newSegment;
+		}
+	}
+	return segment + (bucket & kSymbolSegmentMask);
+}
 
-static String* SymbolTable_lookup(String* list, const char* name, int32_t hash)
+// search the list after prev for key. returns the node if found, otherwise leaves prev and curr
+// on either side of where it belongs. name is empty when searching for a dummy.
+static SymbolNode* searchList(SymbolNode*& prev, SymbolNode*& curr, uint32_t key, std::string_view name)
 {
-	while (list) {
-		if (list->hash == hash && strcmp(list->s, name) == 0)
-			return list;
-		list = list->nextSymbol;
+	curr = prev->next.load(std::memory_order_acquire);
+	while (curr && curr->key <= key) {
+		if (curr->key == key && (!(key & 1) || (strncmp(curr->sym->s, name.data(), name.size()) == 0 && curr->sym->s[name.size()] == 0)))
+			return curr;
+		prev = curr;
+		curr = curr->next.load(std::memory_order_acquire);
 	}
 	return nullptr;
 }
 
-static String* SymbolTable_lookup(const char* name, int hash)
+static SymbolNode* bucketDummy(uint32_t bucket)
 {
-	return SymbolTable_lookup(sSymbolTable[hash & kSymbolTableMask].load(), name, hash);
+	if (bucket == 0) return &sSymbolList;
+	
+	std::atomic<SymbolNode*>* slot = bucketSlot(bucket);
+	SymbolNode* dummy = slot->load(std::memory_order_acquire);
+	if (dummy) return dummy;
+
+	// a new bucket's dummy goes into the run of the bucket it was split from.
+	uint32_t parent = bucket & ~(0x80000000 >> __builtin_clz(bucket));
+	SymbolNode* prev = bucketDummy(parent);
+	uint32_t key = reverseBits(bucket);
+	SymbolNode* node = nullptr;
+	while (1) {
+		SymbolNode* curr;
+		dummy = searchList(prev, curr, key, std::string_view());
+		if (dummy) {
+			delete node;
+			break;
+		}
+		if (!node) node = new SymbolNode(key, nullptr);
+		node->next.store(curr, std::memory_order_relaxed);
+		if (prev->next.compare_exchange_weak(curr, node, std::memory_order_release, std::memory_order_relaxed)) {
+			dummy = node;
+			break;
+		}
+	}
+	// every thread racing to here found or inserted the same dummy.
+	slot->store(dummy, std::memory_order_release);
+	return dummy;
 }
 
-static String* SymbolTable_lookup(const char* name)
+P<String> getsym(const char* name)
 {
-	uintptr_t hash = Hash(name);
-	return SymbolTable_lookup(name, (int)hash);
+	size_t len = strlen(name);
+	return getsym(std::string_view(name, len), Hash(name, len));
 }
 
-P<String> getsym(const char* name)
+P<String> getsym(std::string_view name, int32_t hash)
 {
 	// thread safe
 
-	int32_t hash = Hash(name);
-    int32_t binIndex = hash & kSymbolTableMask;
-	volatile std::atomic<String*>* bin = &sSymbolTable[binIndex];
+	uint32_t key = reverseBits((uint32_t)hash) | 1;
+	uint32_t numBuckets = sSymbolNumBuckets.load(std::memory_order_acquire);
+	SymbolNode* prev = bucketDummy((uint32_t)hash & (numBuckets - 1));
+	SymbolNode* node = nullptr;
 	while (1) {
-        // get the head of the list.
-		String* head = bin->load();
-        // search the list for the symbol
-		String* existingSymbol = head;
-		while (existingSymbol) {
-			if (existingSymbol->hash == hash && strcmp(existingSymbol->s, name) == 0) {
-				return existingSymbol;
+		SymbolNode* curr;
+		SymbolNode* existing = searchList(prev, curr, key, name);
+		if (existing) {
+			if (node) {
+				delete node->sym;
+				delete node;
 			}
-			existingSymbol = existingSymbol->nextSymbol;
+			return existing->sym;
 		}
-		String* newSymbol = new String(name, hash, head);
-		if (bin->compare_exchange_weak(head, newSymbol)) {
-			newSymbol->retain(); 
-			return newSymbol;
-		}
-        delete newSymbol;
-	}	
+		if (!node) node = new SymbolNode(key, new String(name.data(), name.size(), hash));
+		node->next.store(curr, std::memory_order_relaxed);
+		if (prev->next.compare_exchange_weak(curr, node, std::memory_order_release, std::memory_order_relaxed))
+			break;
+	}
+	node->sym->retain();
+	
+	uint32_t count = sSymbolCount.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (count > numBuckets * kSymbolMaxLoad && numBuckets < kSymbolMaxBuckets) {
+		sSymbolNumBuckets.compare_exchange_strong(numBuckets, 2 * numBuckets, std::memory_order_release);
+	}
+	return node->sym;
+}
+
+P<String> findsym(const char* name)
+{
+	// thread safe
+
+	size_t len = strlen(name);
+	int32_t hash = Hash(name, len);
+	uint32_t key = reverseBits((uint32_t)hash) | 1;
+	uint32_t numBuckets = sSymbolNumBuckets.load(std::memory_order_acquire);
+	SymbolNode* prev = bucketDummy((uint32_t)hash & (numBuckets - 1));
+	SymbolNode* curr;
+	SymbolNode* existing = searchList(prev, curr, key, std::string_view(name, len));
+	return existing ? existing->sym : nullptr;
 }